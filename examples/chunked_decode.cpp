@@ -0,0 +1,78 @@
+#include <baklaga/http/chunked.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Decodes `input` in pieces of `step` bytes (0 for all at once), returns
+// the payload or "<error>"
+std::string decode(std::string_view input, size_t step = 0) {
+  baklaga::http::chunked_decoder decoder;
+  std::string payload;
+  std::string pending;
+  for (size_t pos = 0; pos < input.size() || !pending.empty();) {
+    auto size = step == 0 ? input.size() : step;
+    pending.append(input.substr(pos, size));
+    pos += std::min(size, input.size() - pos);
+    auto consumed = decoder.decode(
+        pending, [&](std::string_view data) { payload.append(data); });
+    pending.erase(0, consumed);
+    if (!decoder.error() && decoder.done()) {
+      return payload;
+    } else if (decoder.error() || pos == input.size()) {
+      break;
+    }
+  }
+  return "<error>";
+}
+
+int main() {
+  std::string_view body{
+      "5\r\nHello\r\n"
+      "7 ; name=\"a;b\"\r\n, world\r\n"
+      "0\r\n"
+      "Expires: never\r\n\r\n"};
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  // The same payload wherever the input is split
+  bool same = true;
+  for (size_t step = 1; step <= body.size(); ++step) {
+    same = same && decode(body, step) == "Hello, world";
+  }
+  check("split at every byte", same);
+
+  // A chunk-size line may be max_line bytes long, CRLF not counted
+  constexpr auto max_line = baklaga::http::chunked_decoder::max_line;
+  auto longest = std::string(max_line - 1, '0') + "5\r\nHello\r\n0\r\n\r\n";
+  check("chunk-size line of max_line bytes",
+        decode(longest) == "Hello" && decode(longest, 1) == "Hello");
+
+  // Framing the decoder has to reject
+  auto long_extension =
+      "5;" + std::string(2000, 'x') + "\r\nHello\r\n0\r\n\r\n";
+  auto long_size = std::string(max_line, '0') + "5\r\nHello\r\n0\r\n\r\n";
+  std::pair<std::string_view, std::string_view> malformed[]{
+      {"bare LF after chunk-size", "5\nHello\r\n0\r\n\r\n"},
+      {"bare LF after chunk data", "5\r\nHello\n0\r\n\r\n"},
+      {"CRs after chunk data", "5\r\nHello\r\r\r\n0\r\n\r\n"},
+      {"missing CRLF after chunk data", "5\r\nHelloX\r\n0\r\n\r\n"},
+      {"CR without LF in chunk-size line", "5\rXYZ\nHello\r\n0\r\n\r\n"},
+      {"chunk-ext without ';'", "5 ext\r\nHello\r\n0\r\n\r\n"},
+      {"control character in chunk-ext", "5;a\x01\r\nHello\r\n0\r\n\r\n"},
+      {"overlong chunk-ext", long_extension},
+      {"overlong chunk-size", long_size},
+      {"missing chunk-size", "\r\nHello\r\n0\r\n\r\n"},
+      {"chunk-size overflow", "10000000000000000\r\n"},
+  };
+  for (auto [name, input] : malformed) {
+    check(name, decode(input) == "<error>" && decode(input, 1) == "<error>");
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include <baklaga/http.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+// Answers every request on 127.0.0.1 with "ok" and closes a connection
+// after `per_connection` responses without announcing it, like a server
+// whose keep-alive timeout ran out while the connection was idle
+class loopback_server {
+ public:
+  explicit loopback_server(size_t per_connection)
+      : per_connection_{per_connection} {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    ::bind(listener_, reinterpret_cast<sockaddr*>(&address), size);
+    ::listen(listener_, 8);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread{[this] { run(); }};
+  }
+  ~loopback_server() {
+    ::shutdown(listener_, SHUT_RDWR);
+    thread_.join();
+    ::close(listener_);
+  }
+
+  std::string uri() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/";
+  }
+  int connections() const noexcept { return connections_; }
+
+ private:
+  void run() {
+    for (int fd; (fd = ::accept(listener_, nullptr, nullptr)) >= 0;) {
+      ++connections_;
+      std::string received;
+      char buffer[1024];
+      for (size_t served = 0; served < per_connection_;) {
+        auto end = received.find("\r\n\r\n");
+        if (end == std::string::npos) {
+          auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+          if (size <= 0) {
+            break;
+          }
+          received.append(buffer, static_cast<size_t>(size));
+          continue;
+        }
+        received.erase(0, end + 4);
+        std::string_view response{
+            "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"};
+        ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        ++served;
+      }
+      ::close(fd);
+    }
+  }
+
+  size_t per_connection_;
+  int listener_{-1};
+  uint16_t port_{};
+  std::atomic<int> connections_{};
+  std::thread thread_;
+};
+
+int main() {
+  using namespace baklaga;
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  http::uring_context context;
+  using pool_t = http::connection_pool<http::uring_socket>;
+  auto get = [](pool_t& pool, http::uri_view uri) {
+    std::error_code ec;
+    auto connection = pool.acquire(uri, ec);
+    if (ec) {
+      return false;
+    }
+    http::request request{};
+    request.method(http::method_t::get);
+    request.target("/");
+    request.version(11);
+    if (ec = connection->write(request); ec) {
+      return false;
+    }
+    auto response = connection->read(ec);
+    return !ec && response.body() == "ok";
+  };
+
+  // Sequential requests to one origin share a connection
+  {
+    loopback_server server{100};
+    pool_t pool{{}, [&] { return http::uring_socket{context}; }};
+    auto uri = server.uri();
+    bool ok = true;
+    for (int i = 0; i < 3; ++i) {
+      ok = ok && get(pool, http::uri_view{uri});
+    }
+    check("connection reused",
+          ok && server.connections() == 1 && pool.idle_count() == 1);
+  }
+
+  // The server drops every connection after one response, so the idle one
+  // is stale by the next request, which goes out again on a new connection
+  {
+    loopback_server server{1};
+    pool_t pool{{}, [&] { return http::uring_socket{context}; }};
+    auto uri = server.uri();
+    bool ok = true;
+    for (int i = 0; i < 3; ++i) {
+      ok = ok && get(pool, http::uri_view{uri});
+    }
+    check("stale connection replaced", ok && server.connections() == 3);
+  }
+
+  return failed == 0 ? 0 : 1;
+}
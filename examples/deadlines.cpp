@@ -0,0 +1,180 @@
+#include <baklaga/http.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Reads the request of each connection on 127.0.0.1, sends `reply` and then
+// keeps the connection open without sending anything more, until the
+// client closes it
+class loopback_server {
+ public:
+  explicit loopback_server(std::string reply, int backlog = 8)
+      : reply_{std::move(reply)} {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    address_.sin_family = AF_INET;
+    address_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address_);
+    ::bind(listener_, reinterpret_cast<sockaddr*>(&address_), size);
+    ::listen(listener_, backlog);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address_), &size);
+  }
+  ~loopback_server() {
+    ::shutdown(listener_, SHUT_RDWR);
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    ::close(listener_);
+  }
+
+  void start() {
+    thread_ = std::thread{[this] { run(); }};
+  }
+  std::string uri() const {
+    return "http://127.0.0.1:" + std::to_string(ntohs(address_.sin_port)) +
+           "/";
+  }
+  const sockaddr_in& address() const noexcept { return address_; }
+
+ private:
+  void run() {
+    for (int fd; (fd = ::accept(listener_, nullptr, nullptr)) >= 0;) {
+      std::string received;
+      char buffer[1024];
+      while (received.find("\r\n\r\n") == std::string::npos) {
+        auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+          break;
+        }
+        received.append(buffer, static_cast<size_t>(size));
+      }
+      ::send(fd, reply_.data(), reply_.size(), MSG_NOSIGNAL);
+      while (::recv(fd, buffer, sizeof(buffer), 0) > 0) {
+      }
+      ::close(fd);
+    }
+  }
+
+  std::string reply_;
+  int listener_{-1};
+  sockaddr_in address_{};
+  std::thread thread_;
+};
+
+int main() {
+  using namespace baklaga;
+  using namespace std::chrono_literals;
+  using clock = std::chrono::steady_clock;
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  http::uring_context context;
+  // Sends a GET under `limits`, returns the first error and its duration
+  auto get = [&](const std::string& uri, const http::deadlines& limits,
+                 clock::duration& took) {
+    auto start = clock::now();
+    http::stream<http::uring_socket> http{http::uring_socket{context}};
+    http.deadlines(limits);
+    auto ec = http.connect(http::uri_view{uri});
+    if (!ec) {
+      http::request request{};
+      request.method(http::method_t::get);
+      request.target("/");
+      request.version(11);
+      ec = http.write(request);
+    }
+    if (!ec) {
+      std::string buffer;
+      http.read(buffer, ec);
+    }
+    took = clock::now() - start;
+    return ec;
+  };
+  auto near = [](clock::duration took, clock::duration limit) {
+    return took >= limit && took < limit + 2s;
+  };
+  clock::duration took{};
+
+  // Nothing accepts on a listener with a full backlog, so the handshake
+  // is never answered
+  {
+    loopback_server server{"", 0};
+    std::vector<int> fill;
+    for (int i = 0; i < 8; ++i) {
+      int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      ::connect(fd, reinterpret_cast<const sockaddr*>(&server.address()),
+                sizeof(sockaddr_in));
+      fill.push_back(fd);
+    }
+    std::this_thread::sleep_for(50ms);
+    auto ec = get(server.uri(), {.connect = 100ms}, took);
+    check("connect deadline",
+          ec == http::deadline_error::connect && near(took, 100ms));
+    for (int fd : fill) {
+      ::close(fd);
+    }
+  }
+
+  // The request is read but never answered
+  {
+    loopback_server server{""};
+    server.start();
+    auto ec = get(server.uri(), {.first_byte = 100ms}, took);
+    check("first byte deadline",
+          ec == http::deadline_error::first_byte && near(took, 100ms));
+  }
+
+  // The response stops after the head and part of the body
+  {
+    loopback_server server{
+        "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc"};
+    server.start();
+    auto ec = get(server.uri(), {.first_byte = 1s, .idle = 100ms}, took);
+    check("idle deadline",
+          ec == http::deadline_error::idle && near(took, 100ms));
+  }
+
+  // An expired deadline compares equal to a timeout
+  std::error_code expired = http::deadline_error::idle;
+  check("deadline errors are timeouts", expired == std::errc::timed_out);
+
+  // The timers behind the asynchronous deadlines: a cancelled timer never
+  // fires, the others fire once they are due
+  {
+    struct counted : http::timer_wheel::timer {
+      counted() : timer{[](timer& t) { ++static_cast<counted&>(t).fired; }} {}
+      int fired{};
+    };
+    http::timer_wheel wheel{{.resolution = 1ms, .slots = 8}};
+    counted soon, later, cancelled;
+    auto start = clock::now();
+    wheel.schedule(soon, start + 2ms);
+    wheel.schedule(later, start + 20ms);
+    wheel.schedule(cancelled, start + 5ms);
+    cancelled.cancel();
+    bool ok = wheel.size() == 2;
+    while (!wheel.empty()) {
+      auto wait = std::chrono::milliseconds{wheel.timeout_ms()};
+      std::this_thread::sleep_for(wait);
+      wheel.advance();
+      ok = ok && (later.fired == 0 || soon.fired == 1);
+    }
+    check("timer wheel",
+          ok && soon.fired == 1 && later.fired == 1 && cancelled.fired == 0 &&
+              clock::now() >= start + 20ms);
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <baklaga/http/message.hpp>
+#include <baklaga/http/stream.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+// Plays back a recorded response a few bytes per read
+class replay_socket {
+ public:
+  replay_socket() = default;
+  replay_socket(std::string_view data, size_t step)
+      : data_{data}, step_{step} {}
+
+  void open(std::error_code&) {}
+  void connect(std::string_view, std::string_view, std::error_code&) {}
+  size_t read(std::span<uint8_t> buffer, std::error_code&) {
+    auto size = std::min({buffer.size(), step_, data_.size()});
+    std::memcpy(buffer.data(), data_.data(), size);
+    data_.remove_prefix(size);
+    return size;
+  }
+  size_t write(std::span<const uint8_t> buffer, std::error_code&) {
+    return buffer.size();
+  }
+  void shutdown(std::error_code&) {}
+  void close(std::error_code&) {}
+
+ private:
+  std::string_view data_;
+  size_t step_{};
+};
+
+int main() {
+  using namespace baklaga;
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  // Requests whose body length is ambiguous, a peer could frame them
+  // differently than we do
+  std::pair<std::string_view, std::string_view> ambiguous[]{
+      {"Content-Length with trailing garbage",
+       "POST / HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n"},
+      {"Content-Length list", "POST / HTTP/1.1\r\nContent-Length: 1, 1\r\n\r\n"},
+      {"signed Content-Length", "POST / HTTP/1.1\r\nContent-Length: +1\r\n\r\n"},
+      {"empty Content-Length", "POST / HTTP/1.1\r\nContent-Length: \r\n\r\n"},
+      {"Content-Length overflow",
+       "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n"},
+      {"different duplicate Content-Length",
+       "POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"},
+      {"Content-Length and Transfer-Encoding",
+       "POST / HTTP/1.1\r\nContent-Length: 3\r\n"
+       "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n"},
+      {"Transfer-Encoding not ending in chunked",
+       "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n"},
+  };
+  for (auto [name, message] : ambiguous) {
+    check(name, static_cast<bool>(http::request_view{message}.error()));
+  }
+
+  http::request_view same_length{
+      "POST / HTTP/1.1\r\nContent-Length: 2\r\nContent-Length: 2\r\n\r\nok"};
+  check("identical duplicate Content-Length",
+        !same_length.error() && same_length.body() == "ok");
+
+  std::pair<std::string_view, std::string_view> bad_responses[]{
+      {"Content-Length and Transfer-Encoding in a response",
+       "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n"
+       "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n"},
+      {"status code with trailing garbage", "HTTP/1.1 200x OK\r\n\r\n"},
+      {"four digit status code", "HTTP/1.1 2000 OK\r\n\r\n"},
+  };
+  for (auto [name, message] : bad_responses) {
+    check(name, static_cast<bool>(http::response_view{message}.error()));
+  }
+
+  // Interim responses precede the final one and are not returned
+  std::string_view interim{
+      "HTTP/1.1 100 Continue\r\n\r\n"
+      "HTTP/1.1 103 Early Hints\r\n"
+      "Link: </style.css>; rel=preload\r\n\r\n"
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Length: 2\r\n\r\n"
+      "ok"};
+  auto is_final = [](const http::response_view& response) {
+    return !response.error() &&
+           response.status_code() == http::status_code_t::ok &&
+           response.headers().size() == 1 && response.body() == "ok";
+  };
+  check("interim responses skipped by response_view",
+        is_final(http::response_view{interim}));
+
+  bool skipped = true;
+  for (size_t step = 1; step <= 8; ++step) {
+    http::stream<replay_socket> http{replay_socket{interim, step}};
+    std::string buffer;
+    std::error_code ec;
+    auto response = http.read(buffer, ec);
+    skipped = skipped && !ec && is_final(response);
+  }
+  check("interim responses skipped by stream::read", skipped);
+
+  return failed == 0 ? 0 : 1;
+}
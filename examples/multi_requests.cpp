@@ -0,0 +1,134 @@
+#include <baklaga/http.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Answers each connection on 127.0.0.1 with the Host header and target of
+// its request as the body, then closes it
+class loopback_server {
+ public:
+  loopback_server() {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    ::bind(listener_, reinterpret_cast<sockaddr*>(&address), size);
+    ::listen(listener_, 64);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread{[this] { run(); }};
+  }
+  ~loopback_server() {
+    ::shutdown(listener_, SHUT_RDWR);
+    thread_.join();
+    ::close(listener_);
+  }
+
+  uint16_t port() const noexcept { return port_; }
+
+ private:
+  void run() {
+    for (int fd; (fd = ::accept(listener_, nullptr, nullptr)) >= 0;) {
+      std::string received;
+      char buffer[1024];
+      while (received.find("\r\n\r\n") == std::string::npos) {
+        auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+          break;
+        }
+        received.append(buffer, static_cast<size_t>(size));
+      }
+      baklaga::http::request_view request{received};
+      std::string body{request.headers().at(
+          baklaga::http::header_id_t::host)};
+      body.append(request.target());
+      auto response = "HTTP/1.1 200 OK\r\nContent-Length: " +
+                      std::to_string(body.size()) + "\r\n\r\n" + body;
+      ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+      ::close(fd);
+    }
+  }
+
+  int listener_{-1};
+  uint16_t port_{};
+  std::thread thread_;
+};
+
+int main() {
+  using namespace baklaga;
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  loopback_server server;
+  auto port = std::to_string(server.port());
+
+  http::multi batch{{.max_in_flight = 2}};
+  auto add = [&](std::string uri, http::multi::callback_t callback = {}) {
+    http::request request{};
+    request.method(http::method_t::get);
+    request.version(11);
+    return batch.add(uri, std::move(request), {}, std::move(callback));
+  };
+
+  // More requests than may run at once, to two host names of the server.
+  // The Host header and the target come from the uri.
+  std::string_view hosts[]{"127.0.0.1", "localhost"};
+  std::set<size_t> answered;
+  size_t called{};
+  for (int i = 0; i < 6; ++i) {
+    auto host = hosts[i % 2];
+    auto target = "/" + std::to_string(i);
+    auto uri = "http://" + std::string{host} + ":" + port + target;
+    if (i % 3 == 0) {
+      // Completes through the callback instead of completions()
+      add(uri, [&, expected = std::string{host} + target](
+                   const http::multi::completion& done) {
+        ++called;
+        answered.insert(done.id);
+        check("callback completion " + std::to_string(done.id),
+              !done.error && done.response.body() == expected);
+      });
+    } else {
+      add(uri);
+    }
+  }
+
+  // Nothing listens on the port of a closed listener
+  size_t refused_id{};
+  {
+    loopback_server closed;
+    refused_id = add("http://127.0.0.1:" + std::to_string(closed.port()) + "/");
+  }
+
+  batch.run();
+
+  bool all_ok = batch.in_flight() == 0 && called == 2;
+  bool refused = false;
+  for (const auto& done : batch.completions()) {
+    answered.insert(done.id);
+    if (done.id == refused_id) {
+      refused = static_cast<bool>(done.error);
+      continue;
+    }
+    auto expected = std::string{hosts[done.id % 2]} + "/" +
+                    std::to_string(done.id);
+    all_ok = all_ok && !done.error && done.response.body() == expected;
+  }
+  check("every request completed once", answered.size() == 7);
+  check("Host header and target from the uri", all_ok);
+  check("failed connect reported", refused);
+
+  return failed == 0 ? 0 : 1;
+}
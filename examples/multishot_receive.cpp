@@ -0,0 +1,138 @@
+#include <baklaga/http.hpp>
+#include <baklaga/http/uring.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+// Answers requests on 127.0.0.1 with a body of `body_size` bytes, sent in
+// small pieces so a response takes many receive completions
+class loopback_server {
+ public:
+  explicit loopback_server(size_t body_size) {
+    response_ = "HTTP/1.1 200 OK\r\nContent-Length: " +
+                std::to_string(body_size) + "\r\n\r\n" +
+                std::string(body_size, 'x');
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    ::bind(listener_, reinterpret_cast<sockaddr*>(&address), size);
+    ::listen(listener_, 8);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread{[this] { run(); }};
+  }
+  ~loopback_server() {
+    ::shutdown(listener_, SHUT_RDWR);
+    thread_.join();
+    ::close(listener_);
+  }
+
+  std::string uri() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/";
+  }
+
+ private:
+  void run() {
+    for (int fd; (fd = ::accept(listener_, nullptr, nullptr)) >= 0;) {
+      std::string received;
+      char buffer[1024];
+      for (;;) {
+        auto end = received.find("\r\n\r\n");
+        if (end == std::string::npos) {
+          auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+          if (size <= 0) {
+            break;
+          }
+          received.append(buffer, static_cast<size_t>(size));
+          continue;
+        }
+        received.erase(0, end + 4);
+        for (size_t pos = 0; pos < response_.size(); pos += 1000) {
+          auto piece = std::string_view{response_}.substr(pos, 1000);
+          ::send(fd, piece.data(), piece.size(), MSG_NOSIGNAL);
+        }
+      }
+      ::close(fd);
+    }
+  }
+
+  std::string response_;
+  int listener_{-1};
+  uint16_t port_{};
+  std::thread thread_;
+};
+
+baklaga::http::task<void> fetch(baklaga::http::uring_context& context,
+                                std::string uri, size_t body_size, int count,
+                                bool& ok) {
+  using namespace baklaga;
+
+  http::async_stream<http::uring_async_socket> stream{
+      http::uring_async_socket{context}};
+  stream.keep_alive(true);
+  auto ec = co_await stream.connect(http::uri_view{uri});
+  for (int i = 0; i < count && !ec; ++i) {
+    http::request request{};
+    request.method(http::method_t::get);
+    request.target("/");
+    request.version(11);
+    if (ec = co_await stream.write(request); ec) {
+      break;
+    }
+    std::string buffer;
+    auto response = co_await stream.read(buffer, ec);
+    ok = ok && !ec && response.body().size() == body_size;
+  }
+  ok = ok && !ec;
+}
+
+int main() {
+  using namespace baklaga;
+
+  if (!http::uring_context::supported()) {
+    std::cout << "skipped: no io_uring" << std::endl;
+    return 0;
+  }
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  // The receive stays armed across reads and responses, wherever the
+  // provided buffers come from
+  for (bool ring : {true, false}) {
+    loopback_server server{64 * 1024};
+    http::uring_context context{{.buffer_ring = ring}};
+    bool armed = context.multishot();
+    bool ok = true;
+    context.spawn(fetch(context, server.uri(), 64 * 1024, 4, ok));
+    context.run();
+    check(ring ? "multishot with a buffer ring"
+               : "multishot with IORING_OP_PROVIDE_BUFFERS",
+          armed && ok && context.multishot());
+  }
+
+  // Two small buffers run out all the time, reads then fall back to a
+  // single receive without turning multishot off for good
+  {
+    loopback_server server{64 * 1024};
+    http::uring_context context{{.buffer_count = 2, .buffer_size = 64}};
+    bool ok = true;
+    context.spawn(fetch(context, server.uri(), 64 * 1024, 4, ok));
+    context.run();
+    check("multishot kept when buffers run out", ok && context.multishot());
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+#include <baklaga/http.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+// Answers each request on 127.0.0.1 with its target as the body. The
+// first connection is closed after `first_connection` responses without
+// announcing it, in the middle of a pipelined batch
+class loopback_server {
+ public:
+  explicit loopback_server(size_t first_connection)
+      : first_connection_{first_connection} {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    ::bind(listener_, reinterpret_cast<sockaddr*>(&address), size);
+    ::listen(listener_, 8);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread{[this] { run(); }};
+  }
+  ~loopback_server() {
+    ::shutdown(listener_, SHUT_RDWR);
+    thread_.join();
+    ::close(listener_);
+  }
+
+  std::string uri() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/";
+  }
+  int connections() const noexcept { return connections_; }
+
+ private:
+  void run() {
+    for (int fd; (fd = ::accept(listener_, nullptr, nullptr)) >= 0;) {
+      auto limit = ++connections_ == 1 ? first_connection_ : SIZE_MAX;
+      std::string received;
+      char buffer[1024];
+      for (size_t served = 0; served < limit;) {
+        auto end = received.find("\r\n\r\n");
+        if (end == std::string::npos) {
+          auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+          if (size <= 0) {
+            break;
+          }
+          received.append(buffer, static_cast<size_t>(size));
+          continue;
+        }
+        // "GET /a HTTP/1.1" answers "/a"
+        auto target_begin = received.find(' ') + 1;
+        auto target = received.substr(
+            target_begin, received.find(' ', target_begin) - target_begin);
+        auto body_size = std::to_string(target.size());
+        received.erase(0, end + 4);
+        auto response = "HTTP/1.1 200 OK\r\nContent-Length: " + body_size +
+                        "\r\n\r\n" + target;
+        ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        ++served;
+      }
+      ::close(fd);
+    }
+  }
+
+  size_t first_connection_;
+  int listener_{-1};
+  uint16_t port_{};
+  std::atomic<int> connections_{};
+  std::thread thread_;
+};
+
+int main() {
+  using namespace baklaga;
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  http::uring_context context;
+  auto make = [](http::method_t method, std::string_view target) {
+    http::request request{};
+    request.method(method);
+    request.target(target);
+    request.version(11);
+    return request;
+  };
+  std::string_view targets[]{"/a", "/b", "/c", "/d"};
+
+  // The connection closes after two of four responses. The rest of the
+  // batch is idempotent, so read() sends it again on a new connection.
+  {
+    loopback_server server{2};
+    http::stream<http::uring_socket> http{http::uring_socket{context}};
+    http.pipeline_depth(4);
+    auto uri = server.uri();
+    bool ok = !http.connect(http::uri_view{uri});
+    http::request requests[]{make(http::method_t::get, targets[0]),
+                             make(http::method_t::get, targets[1]),
+                             make(http::method_t::get, targets[2]),
+                             make(http::method_t::get, targets[3])};
+    for (auto& request : requests) {
+      ok = ok && !http.enqueue(request);
+    }
+    ok = ok && !http.flush();
+    std::string buffer;
+    for (auto target : targets) {
+      std::error_code ec;
+      auto response = http.read(buffer, ec);
+      ok = ok && !ec && response.body() == target;
+    }
+    check("idempotent batch retried after close",
+          ok && server.connections() == 2 && http.pending() == 0);
+  }
+
+  // A POST among the unanswered requests is not repeated behind the
+  // caller's back; retry() sends the rest once the caller decides to
+  {
+    loopback_server server{1};
+    http::stream<http::uring_socket> http{http::uring_socket{context}};
+    http.pipeline_depth(4);
+    auto uri = server.uri();
+    bool ok = !http.connect(http::uri_view{uri});
+    http::request requests[]{make(http::method_t::get, targets[0]),
+                             make(http::method_t::post, targets[1]),
+                             make(http::method_t::get, targets[2])};
+    for (auto& request : requests) {
+      ok = ok && !http.enqueue(request);
+    }
+    ok = ok && !http.flush();
+
+    std::string buffer;
+    std::error_code ec;
+    auto first = http.read(buffer, ec);
+    ok = ok && !ec && first.body() == targets[0];
+    http.read(buffer, ec);
+    bool refused = ec && server.connections() == 1 && http.pending() == 2;
+
+    ok = ok && !http.retry();
+    for (auto target : {targets[1], targets[2]}) {
+      std::error_code error;
+      auto response = http.read(buffer, error);
+      ok = ok && !error && response.body() == target;
+    }
+    check("non-idempotent batch left to the caller",
+          ok && refused && server.connections() == 2);
+  }
+
+  return failed == 0 ? 0 : 1;
+}
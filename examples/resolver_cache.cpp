@@ -0,0 +1,217 @@
+#include <baklaga/http.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Answers every connection on 127.0.0.1 with "ok" and closes it
+class loopback_server {
+ public:
+  loopback_server() {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    ::bind(listener_, reinterpret_cast<sockaddr*>(&address), size);
+    ::listen(listener_, 8);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread{[this] { run(); }};
+  }
+  ~loopback_server() {
+    ::shutdown(listener_, SHUT_RDWR);
+    thread_.join();
+    ::close(listener_);
+  }
+
+  uint16_t port() const noexcept { return port_; }
+
+ private:
+  void run() {
+    for (int fd; (fd = ::accept(listener_, nullptr, nullptr)) >= 0;) {
+      std::string received;
+      char buffer[1024];
+      while (received.find("\r\n\r\n") == std::string::npos) {
+        auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+          break;
+        }
+        received.append(buffer, static_cast<size_t>(size));
+      }
+      std::string_view response{
+          "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"};
+      ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+      ::close(fd);
+    }
+  }
+
+  int listener_{-1};
+  uint16_t port_{};
+  std::thread thread_;
+};
+
+// Answers from a hosts file like file_resolver, slowly, and counts lookups
+class counting_resolver {
+ public:
+  explicit counting_resolver(std::string path)
+      : backend_{std::move(path)},
+        lookups_{std::make_shared<std::atomic<int>>()} {}
+
+  baklaga::http::resolution resolve(std::string_view host,
+                                    std::error_code& ec) const {
+    ++*lookups_;
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    return backend_.resolve(host, ec);
+  }
+  int lookups() const noexcept { return *lookups_; }
+
+ private:
+  baklaga::http::file_resolver backend_;
+  std::shared_ptr<std::atomic<int>> lookups_;
+};
+
+void write_hosts(const std::string& path, std::string_view text) {
+  if (auto* file = std::fopen(path.c_str(), "wb")) {
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+  }
+}
+
+int main() {
+  using namespace baklaga;
+  using namespace std::chrono_literals;
+  using clock = std::chrono::steady_clock;
+
+  int failed{};
+  auto check = [&](std::string_view name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << std::endl;
+    failed += ok ? 0 : 1;
+  };
+
+  auto path = "/tmp/baklaga_hosts_" + std::to_string(::getpid());
+  // Resolves `host` through `cache`, returns the first address and how
+  // long the call took
+  auto lookup = [](auto& cache, std::string_view host,
+                   clock::duration& took) {
+    auto start = clock::now();
+    std::error_code ec;
+    auto found = cache.resolve(host, ec);
+    took = clock::now() - start;
+    return ec || found.empty() ? std::string{}
+                               : found.addresses()[0].to_string();
+  };
+  clock::duration took{};
+
+  // The stub reads the file on every call
+  {
+    http::file_resolver resolver{path};
+    write_hosts(path, "# comment\nexample.test 60 127.0.0.3 ::1\n");
+    std::error_code ec;
+    auto found = resolver.resolve("EXAMPLE.test", ec);
+    bool ok = !ec && found.ttl() == 60s && found.addresses().size() == 2 &&
+              found.addresses()[1].to_string() == "::1";
+    std::error_code unknown;
+    resolver.resolve("other.test", unknown);
+    check("file_resolver", ok && unknown == std::errc::host_unreachable);
+  }
+
+  // Concurrent lookups of one host wait for a single backend call
+  {
+    write_hosts(path, "example.test 60 127.0.0.3\n");
+    http::resolver_cache<counting_resolver> cache{counting_resolver{path}};
+    std::vector<std::thread> threads;
+    std::atomic<int> answered{};
+    for (int i = 0; i < 8; ++i) {
+      threads.emplace_back([&] {
+        clock::duration unused{};
+        answered += lookup(cache, "example.test", unused) == "127.0.0.3";
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    check("concurrent lookups coalesced",
+          answered == 8 && cache.backend().lookups() == 1);
+  }
+
+  // Without background refresh an expired answer is resolved again, and the
+  // caller waits for it
+  {
+    write_hosts(path, "example.test 1 127.0.0.3\n");
+    http::resolver_cache<counting_resolver> cache{
+        counting_resolver{path}, {.background_refresh = false}};
+    bool ok = lookup(cache, "example.test", took) == "127.0.0.3";
+    ok = ok && lookup(cache, "example.test", took) == "127.0.0.3" &&
+         took < 50ms;
+    write_hosts(path, "example.test 1 127.0.0.4\n");
+    std::this_thread::sleep_for(1100ms);
+    ok = ok && lookup(cache, "example.test", took) == "127.0.0.4" &&
+         took >= 100ms;
+    check("TTL expiry", ok && cache.backend().lookups() == 2);
+  }
+
+  // A hit in the last half of the TTL refreshes the entry in the
+  // background, so the caller never waits once the first answer expires
+  {
+    write_hosts(path, "example.test 1 127.0.0.3\n");
+    http::resolver_cache<counting_resolver> cache{counting_resolver{path},
+                                                  {.refresh_ahead = 0.5}};
+    auto start = clock::now();
+    bool ok = lookup(cache, "example.test", took) == "127.0.0.3";
+    write_hosts(path, "example.test 1 127.0.0.4\n");
+    std::this_thread::sleep_until(start + 700ms);
+    ok = ok && lookup(cache, "example.test", took) == "127.0.0.3" &&
+         took < 50ms;
+    std::this_thread::sleep_until(start + 1300ms);
+    ok = ok && lookup(cache, "example.test", took) == "127.0.0.4" &&
+         took < 50ms;
+    check("background refresh", ok && cache.backend().lookups() == 2);
+  }
+
+  // The stream connects to the cached addresses instead of letting the
+  // socket resolve the name
+  {
+    loopback_server server;
+    write_hosts(path, "example.test 60 127.0.0.1\n");
+    http::resolver_cache<http::file_resolver> cache{
+        http::file_resolver{path}};
+    http::uring_context context;
+    bool ok = true;
+    for (int i = 0; i < 2; ++i) {
+      http::stream<http::uring_socket> http{http::uring_socket{context}};
+      http.resolver(cache);
+      auto uri =
+          "http://example.test:" + std::to_string(server.port()) + "/";
+      auto ec = http.connect(http::uri_view{uri});
+      http::request request{};
+      request.method(http::method_t::get);
+      request.target("/");
+      request.version(11);
+      if (!ec) {
+        ec = http.write(request);
+      }
+      std::string buffer;
+      if (!ec) {
+        auto response = http.read(buffer, ec);
+        ok = ok && response.body() == "ok";
+      }
+      ok = ok && !ec;
+    }
+    check("stream connects through the cache", ok && cache.size() == 1);
+  }
+
+  std::remove(path.c_str());
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include <baklaga/http/stream.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+// Plays back a recorded response a few bytes per read, like a slow server
+class replay_socket {
+ public:
+  replay_socket() = default;
+  replay_socket(std::string_view data, size_t step)
+      : data_{data}, step_{step} {}
+
+  void open(std::error_code&) {}
+  void connect(std::string_view, std::string_view, std::error_code&) {}
+  size_t read(std::span<uint8_t> buffer, std::error_code&) {
+    auto size = std::min({buffer.size(), step_, data_.size()});
+    std::memcpy(buffer.data(), data_.data(), size);
+    data_.remove_prefix(size);
+    return size;
+  }
+  size_t write(std::span<const uint8_t> buffer, std::error_code&) {
+    return buffer.size();
+  }
+  void shutdown(std::error_code&) {}
+  void close(std::error_code&) {}
+
+ private:
+  std::string_view data_;
+  size_t step_{};
+};
+
+int main() {
+  using namespace baklaga;
+
+  std::string_view response_str{
+      "HTTP/1.1 200 OK\r\n"
+      "Server: baklaga\r\n"
+      "Content-Type: text/plain\r\n"
+      "Transfer-Encoding: chunked\r\n\r\n"
+      "5\r\nHello\r\n"
+      "7\r\n, world\r\n"
+      "0\r\n\r\n"};
+
+  // The header block arrives in many reads and the buffer grows meanwhile,
+  // the parser still scans every byte once
+  int failed{};
+  for (size_t step = 1; step <= 8; ++step) {
+    http::stream<replay_socket> http{replay_socket{response_str, step}};
+    std::string buffer;
+    std::error_code ec;
+    auto response = http.read(buffer, ec);
+
+    bool ok = !ec && response.status_code() == http::status_code_t::ok &&
+              response.headers().size() == 3 &&
+              response.headers().at(http::header_id_t::content_type) ==
+                  "text/plain" &&
+              response.body() == "Hello, world";
+    if (!ok) {
+      std::cout << "step " << step << ": unexpected response" << std::endl;
+      ++failed;
+    } else if (step == 1) {
+      std::cout << "> Response:\n";
+      for (const auto& [name, content] : response.headers()) {
+        std::cout << name << ": " << content << std::endl;
+      }
+      std::cout << "\n" << response.body() << std::endl;
+    }
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -3,8 +3,22 @@
 
 #include "baklaga/http/uri.hpp"
 #include "baklaga/http/uri_encode.hpp"
+#include "baklaga/http/uri_batch.hpp"
+#include "baklaga/http/chunked.hpp"
+#include "baklaga/http/parser.hpp"
 #include "baklaga/http/message.hpp"
+#include "baklaga/http/buffer_pool.hpp"
+#include "baklaga/http/timer_wheel.hpp"
+#include "baklaga/http/resolver.hpp"
+#include "baklaga/http/file_sink.hpp"
+#include "baklaga/http/body_source.hpp"
 #include "baklaga/http/stream.hpp"
+#include "baklaga/http/connection_pool.hpp"
+#include "baklaga/http/task.hpp"
+#include "baklaga/http/async_stream.hpp"
+#include "baklaga/http/epoll.hpp"
+#include "baklaga/http/uring.hpp"
+#include "baklaga/http/multi.hpp"
 #include "baklaga/http/method.hpp"
 
 #endif // BAKLAGA_HTTP_HPP
@@ -0,0 +1,307 @@
+#ifndef BAKLAGA_HTTP_ASYNC_STREAM_HPP
+#define BAKLAGA_HTTP_ASYNC_STREAM_HPP
+
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "baklaga/http/buffer_pool.hpp"
+#include "baklaga/http/concept/buffer.hpp"
+#include "baklaga/http/concept/resolver.hpp"
+#include "baklaga/http/concept/socket.hpp"
+#include "baklaga/http/detail/buffer.hpp"
+#include "baklaga/http/detail/response_reader.hpp"
+#include "baklaga/http/message.hpp"
+#include "baklaga/http/resolver.hpp"
+#include "baklaga/http/task.hpp"
+#include "baklaga/http/timer_wheel.hpp"
+#include "baklaga/http/uri.hpp"
+
+namespace baklaga::http {
+/// Coroutine counterpart of stream: the same request serialization and
+/// response parsing over an async_socket. Each operation is one task frame,
+/// buffers are kept across requests.
+template <concept_::async_socket Socket>
+class async_stream {
+ public:
+  async_stream() = default;
+  async_stream(Socket&& socket) : socket_(std::move(socket)) {}
+  /// See stream(Socket&&, buffer_pool&). The coroutines have to be resumed
+  /// on the thread of the pool.
+  async_stream(Socket&& socket, buffer_pool& pool)
+      : socket_(std::move(socket)), receive_buffer_{pool} {}
+
+  task<std::error_code> connect(http::uri_view uri) {
+    host_ = uri.authority().hostname();
+    std::array<char, 8> port{};
+    auto [port_end, _] =
+        std::to_chars(port.data(), port.data() + port.size(), uri.port());
+    reusable_ = false;
+    disarm_all();
+    arm(deadline_error::total);
+    arm(deadline_error::connect);
+
+    std::error_code ec;
+    socket_.open(ec);
+#if defined(__linux__)
+    if constexpr (concept_::async_address_socket<Socket>) {
+      if (!ec && resolve_) {
+        auto found = resolve_(host_, ec);
+        if (!ec && found.empty()) {
+          ec = std::make_error_code(std::errc::host_unreachable);
+        }
+        for (auto address : found.addresses()) {
+          address.port(uri.port());
+          co_await socket_.async_connect(address, ec);
+          if (!ec || ec.category() == deadline_category()) {
+            break;
+          }
+        }
+        disarm(deadline_error::connect);
+        if (ec) {
+          disarm_all();
+        }
+        co_return ec;
+      }
+    }
+#endif
+    if (!ec) {
+      co_await socket_.async_connect(
+          host_, std::string_view{port.data(), port_end}, ec);
+    }
+    disarm(deadline_error::connect);
+    if (ec) {
+      disarm_all();
+    }
+    co_return ec;
+  }
+
+  /// See stream::keep_alive()
+  void keep_alive(bool v) noexcept { keep_alive_ = v; }
+  /// See stream::reusable()
+  bool reusable() const noexcept { return reusable_; }
+
+  /// Limits the time of each request. The timers run on the timer wheel of
+  /// the socket's executor; an expired deadline cancels the pending socket
+  /// operation, which then fails with the deadline_error, and the
+  /// connection cannot be reused.
+  void deadlines(const http::deadlines& limits)
+    requires concept_::cancellable_socket<Socket>
+  {
+    deadlines_ = limits;
+    if (limits && !timers_) {
+      timers_ = std::make_unique<timers_t>();
+    }
+  }
+  const http::deadlines& deadlines() const noexcept { return deadlines_; }
+
+#if defined(__linux__)
+  /// See stream::resolver(). The lookup itself is a blocking call, so a
+  /// cache in front of the actual resolver is what keeps the loop moving.
+  template <concept_::resolver ResolverTy>
+    requires concept_::async_address_socket<Socket>
+  void resolver(ResolverTy& r) {
+    resolve_ = [&r](std::string_view host, std::error_code& ec) {
+      return r.resolve(host, ec);
+    };
+  }
+#endif
+
+  /// Sends `request` followed by `body`.
+  task<std::error_code> write(http::request& request,
+                              std::string_view body = {}) {
+    detail::fill_basic_data(request, host_, keep_alive_);
+    request_method_ = request.method();
+    reusable_ = false;
+
+    write_buffer_.clear();
+    request.append_to(write_buffer_);
+    write_buffer_.append(body);
+
+    if (!armed(deadline_error::total)) {
+      arm(deadline_error::total);
+    }
+    arm(deadline_error::idle);
+
+    std::error_code ec;
+    auto pending = detail::as_bytes(write_buffer_);
+    while (!pending.empty()) {
+      auto written = co_await socket_.async_write(pending, ec);
+      if (ec) {
+        break;
+      } else if (written == 0) {
+        ec = std::make_error_code(std::errc::connection_aborted);
+        break;
+      }
+      pending = pending.subspan(written);
+      arm(deadline_error::idle);
+    }
+    disarm(deadline_error::idle);
+    if (ec) {
+      disarm_all();
+    }
+    co_return ec;
+  }
+
+  /// Receives a response into `buffer`, see stream::read().
+  template <concept_::ReadBuffer BufferTy>
+  task<http::response_view> read(BufferTy& buffer, std::error_code& ec) {
+    cursor_.drop(buffer);
+
+    detail::response_reader reader{request_method_};
+    auto gather = [&](std::string_view piece) {
+      reader.gather_body(reinterpret_cast<char*>(std::ranges::data(buffer)),
+                         piece);
+    };
+    size_t received = std::ranges::size(buffer);
+    if (!armed(deadline_error::total)) {
+      arm(deadline_error::total);
+    }
+    arm(received == 0 ? deadline_error::first_byte : deadline_error::idle);
+
+    for (;;) {
+      auto event = reader.next(detail::as_view(buffer, received), gather);
+      if (event == parse_event_t::done) {
+        break;
+      } else if (event == parse_event_t::error) {
+        ec = reader.parser().error();
+        disarm_all();
+        co_return http::response_view{};
+      }
+
+      auto bytes_read = co_await socket_.async_read(
+          detail::receive_space(buffer, received, read_chunk_size), ec);
+      received += bytes_read;
+      buffer.resize(received);
+      if (!ec && bytes_read != 0) {
+        disarm(deadline_error::first_byte);
+        arm(deadline_error::idle);
+        continue;
+      } else if (!ec && reader.finish()) {
+        // End of stream completes a close-delimited body
+        break;
+      }
+      if (!ec) {
+        ec = std::make_error_code(std::errc::connection_aborted);
+      }
+      disarm_all();
+      co_return http::response_view{};
+    }
+
+    disarm_all();
+    cursor_.consumed(buffer, reader.parser().body_offset());
+    reusable_ = keep_alive_ && reader.persistent();
+    co_return reader.response(detail::as_view(buffer, received));
+  }
+
+  /// Receives a response into the receive buffer of the connection, see
+  /// stream::read(std::error_code&).
+  task<http::response_view> read(std::error_code& ec) {
+    co_return co_await read(receive_buffer_, ec);
+  }
+
+  /// Closes the connection, errors are ignored.
+  void shutdown() {
+    std::error_code ec;
+    socket_.shutdown(ec);
+    socket_.close(ec);
+    reusable_ = false;
+  }
+
+  Socket& socket() noexcept { return socket_; }
+
+ private:
+  static constexpr size_t read_chunk_size = 4096;
+
+  /// Timer of one deadline, fired by the wheel of the socket's executor
+  struct deadline_timer : timer_wheel::timer {
+    deadline_timer() noexcept : timer_wheel::timer{&deadline_timer::expire} {}
+
+    static void expire(timer_wheel::timer& t) {
+      auto& self = static_cast<deadline_timer&>(t);
+      self.stream->expire(self.kind);
+    }
+
+    // Set when armed, so the stream may move between requests
+    async_stream* stream{};
+    deadline_error kind{};
+  };
+  using timers_t = std::array<deadline_timer, 4>;
+
+  deadline_timer* timer_of(deadline_error kind) const noexcept {
+    return timers_ ? &(*timers_)[static_cast<size_t>(kind) - 1] : nullptr;
+  }
+  bool armed(deadline_error kind) const noexcept {
+    auto* t = timer_of(kind);
+    return t != nullptr && t->armed();
+  }
+
+  void arm(deadline_error kind) {
+    if constexpr (concept_::cancellable_socket<Socket>) {
+      http::deadlines::duration limit{};
+      switch (kind) {
+        case deadline_error::connect:
+          limit = deadlines_.connect;
+          break;
+        case deadline_error::first_byte:
+          limit = deadlines_.first_byte;
+          break;
+        case deadline_error::idle:
+          limit = deadlines_.idle;
+          break;
+        case deadline_error::total:
+          limit = deadlines_.total;
+          break;
+      }
+      auto* t = timer_of(kind);
+      if (t != nullptr && limit.count() != 0) {
+        t->stream = this;
+        t->kind = kind;
+        socket_.timers().schedule(*t, limit);
+      }
+    }
+  }
+  void disarm(deadline_error kind) noexcept {
+    if (auto* t = timer_of(kind)) {
+      t->cancel();
+    }
+  }
+  void disarm_all() noexcept {
+    if (timers_) {
+      for (auto& t : *timers_) {
+        t.cancel();
+      }
+    }
+  }
+
+  void expire(deadline_error kind) {
+    if constexpr (concept_::cancellable_socket<Socket>) {
+      disarm_all();
+      reusable_ = false;
+      socket_.cancel(make_error_code(kind));
+    }
+  }
+
+  Socket socket_;
+  std::string host_;
+  std::string write_buffer_;
+  method_t request_method_{method_t::get};
+  bool keep_alive_{};
+  bool reusable_{};
+  detail::receive_cursor cursor_;
+  receive_buffer receive_buffer_;
+  http::deadlines deadlines_;
+  std::unique_ptr<timers_t> timers_;
+#if defined(__linux__)
+  std::function<resolution(std::string_view, std::error_code&)> resolve_;
+#endif
+};
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_ASYNC_STREAM_HPP
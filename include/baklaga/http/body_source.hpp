@@ -0,0 +1,187 @@
+#ifndef BAKLAGA_HTTP_BODY_SOURCE_HPP
+#define BAKLAGA_HTTP_BODY_SOURCE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#endif
+
+#include "baklaga/http/concept/body.hpp"
+
+namespace baklaga::http {
+/// Body already in memory, sent as a single piece. The viewed storage has
+/// to outlive the write.
+class memory_body {
+ public:
+  explicit memory_body(std::string_view data) noexcept : data_{data} {}
+
+  std::optional<uint64_t> size() const noexcept { return data_.size(); }
+  std::string_view read(std::error_code&) noexcept {
+    return std::exchange(data_, {});
+  }
+
+ private:
+  std::string_view data_;
+};
+
+/// Body produced on demand by `fn()`, which returns the next piece and an
+/// empty view at the end. Sent chunked unless the total size is given.
+template <typename Fn>
+class generator_body {
+ public:
+  explicit generator_body(Fn fn, std::optional<uint64_t> size = {})
+      : fn_{std::move(fn)}, size_{size} {}
+
+  std::optional<uint64_t> size() const noexcept { return size_; }
+  std::string_view read(std::error_code&) { return fn_(); }
+
+ private:
+  Fn fn_;
+  std::optional<uint64_t> size_;
+};
+
+#if defined(__linux__)
+/// A range of a file, sent with sendfile over sockets that opt into it
+/// (see concept_::direct_io_socket) and read with pread otherwise. The
+/// descriptor is not owned and its file position is left alone.
+class file_body {
+ public:
+  /// From the current position of `fd` to the end of the file
+  file_body(int fd, std::error_code& ec) noexcept : fd_{fd} {
+    struct stat info {};
+    auto position = ::lseek(fd, 0, SEEK_CUR);
+    if (position < 0 || ::fstat(fd, &info) != 0) {
+      ec = {errno, std::system_category()};
+      return;
+    }
+    offset_ = position;
+    remaining_ =
+        static_cast<uint64_t>(std::max<off_t>(info.st_size - position, 0));
+  }
+  file_body(int fd, uint64_t offset, uint64_t size) noexcept
+      : fd_{fd}, offset_{static_cast<off_t>(offset)}, remaining_{size} {}
+
+  std::optional<uint64_t> size() const noexcept { return remaining_; }
+
+  uint64_t transfer(int socket, std::error_code& ec) noexcept {
+    while (remaining_ != 0) {
+      auto sent = ::sendfile(socket, fd_, &offset_,
+                             static_cast<size_t>(
+                                 std::min<uint64_t>(remaining_, max_transfer)));
+      if (sent > 0) {
+        remaining_ -= static_cast<uint64_t>(sent);
+        return static_cast<uint64_t>(sent);
+      } else if (sent == 0) {
+        // The file is shorter than announced
+        ec = std::make_error_code(std::errc::message_size);
+        return 0;
+      } else if (errno != EINTR) {
+        ec = {errno, std::system_category()};
+        return 0;
+      }
+    }
+    return 0;
+  }
+
+  std::string_view read(std::error_code& ec) {
+    if (remaining_ == 0) {
+      return {};
+    }
+    if (!buffer_) {
+      buffer_.reset(new char[read_size]);
+    }
+    for (;;) {
+      auto result = ::pread(fd_, buffer_.get(),
+                            static_cast<size_t>(
+                                std::min<uint64_t>(remaining_, read_size)),
+                            offset_);
+      if (result > 0) {
+        offset_ += result;
+        remaining_ -= static_cast<uint64_t>(result);
+        return {buffer_.get(), static_cast<size_t>(result)};
+      } else if (result == 0) {
+        ec = std::make_error_code(std::errc::message_size);
+        return {};
+      } else if (errno != EINTR) {
+        ec = {errno, std::system_category()};
+        return {};
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t read_size = 64 * 1024;
+  // sendfile moves at most about 2 GiB per call
+  static constexpr uint64_t max_transfer = 1 << 30;
+
+  int fd_;
+  off_t offset_{};
+  uint64_t remaining_{};
+  std::unique_ptr<char[]> buffer_;
+};
+
+/// A whole file mapped into memory and sent from the mapping as a single
+/// piece, so the socket copies straight from the page cache. Useful for
+/// sockets without direct I/O (e.g. TLS), where file_body has to read into
+/// a buffer first.
+class mapped_body {
+ public:
+  mapped_body(int fd, std::error_code& ec) noexcept {
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ec = {errno, std::system_category()};
+      return;
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ == 0) {
+      return;
+    }
+    auto* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      ec = {errno, std::system_category()};
+      size_ = 0;
+      return;
+    }
+    ::madvise(map, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(map);
+  }
+  mapped_body(mapped_body&& other) noexcept
+      : data_{std::exchange(other.data_, nullptr)},
+        size_{std::exchange(other.size_, 0)},
+        sent_{other.sent_} {}
+  mapped_body& operator=(mapped_body&&) = delete;
+  ~mapped_body() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  std::optional<uint64_t> size() const noexcept { return size_; }
+  std::string_view read(std::error_code&) noexcept {
+    if (std::exchange(sent_, true) || data_ == nullptr) {
+      return {};
+    }
+    return {data_, size_};
+  }
+
+ private:
+  const char* data_{};
+  size_t size_{};
+  bool sent_{};
+};
+#endif  // defined(__linux__)
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_BODY_SOURCE_HPP
@@ -0,0 +1,224 @@
+#ifndef BAKLAGA_HTTP_BUFFER_POOL_HPP
+#define BAKLAGA_HTTP_BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace baklaga::http {
+/// Hands out receive blocks in power-of-two size classes from 4 KiB to
+/// 1 MiB. Blocks are carved from slabs and go back to a free list of their
+/// class, so buffers of finished requests are reused without reaching the
+/// allocator, and none of them is ever zero-filled. Larger blocks are
+/// allocated directly. Not thread-safe: a pool and every buffer using it
+/// belong to the thread that first acquires a block, which debug builds
+/// assert.
+class buffer_pool {
+ public:
+  static constexpr size_t min_block_size = 4096;
+  static constexpr size_t class_count = 9;
+  static constexpr size_t max_block_size = min_block_size << (class_count - 1);
+  /// Blocks of the small classes are allocated this many bytes at a time
+  static constexpr size_t slab_size = 64 * 1024;
+
+  buffer_pool() = default;
+  buffer_pool(const buffer_pool&) = delete;
+  buffer_pool& operator=(const buffer_pool&) = delete;
+
+  /// Pool of the calling thread. It is destroyed at thread exit, buffers
+  /// using it must be released on that thread before.
+  static buffer_pool& local() {
+    static thread_local buffer_pool pool;
+    return pool;
+  }
+
+  /// Size of the block acquire() returns for `size` bytes
+  static constexpr size_t block_size(size_t size) noexcept {
+    return size <= min_block_size ? min_block_size : std::bit_ceil(size);
+  }
+
+  /// A block of at least `size` bytes with unspecified contents
+  std::span<uint8_t> acquire(size_t size) {
+    check_thread();
+    auto block = block_size(size);
+    if (block > max_block_size) {
+      return {new uint8_t[block], block};
+    }
+
+    auto index = size_class(block);
+    auto& free = free_[index];
+    if (free.empty()) {
+      auto count = std::max<size_t>(slab_size / block, 1);
+      // Room for every block of the class, so release() never allocates
+      free.reserve(carved_[index] += count);
+      auto& slab = slabs_.emplace_back(new uint8_t[block * count]);
+      for (size_t i = count; i-- > 0;) {
+        free.push_back(slab.get() + i * block);
+      }
+    }
+    auto* data = free.back();
+    free.pop_back();
+    return {data, block};
+  }
+
+  /// Takes back a block returned by acquire().
+  void release(std::span<uint8_t> block) noexcept {
+    if (block.empty()) {
+      return;
+    }
+    check_thread();
+    if (block.size() > max_block_size) {
+      delete[] block.data();
+      return;
+    }
+    free_[size_class(block.size())].push_back(block.data());
+  }
+
+  /// Blocks ready to be handed out without allocating
+  size_t free_blocks() const noexcept {
+    size_t count{};
+    for (auto& free : free_) {
+      count += free.size();
+    }
+    return count;
+  }
+
+ private:
+  static size_t size_class(size_t block) noexcept {
+    return static_cast<size_t>(std::countr_zero(block) -
+                               std::countr_zero(min_block_size));
+  }
+
+  void check_thread() noexcept {
+#ifndef NDEBUG
+    auto id = std::this_thread::get_id();
+    if (owner_ == std::thread::id{}) {
+      owner_ = id;
+    }
+    assert(owner_ == id && "buffer_pool used by several threads");
+#endif
+  }
+
+  std::array<std::vector<uint8_t*>, class_count> free_;
+  std::array<size_t, class_count> carved_{};
+  std::vector<std::unique_ptr<uint8_t[]>> slabs_;
+#ifndef NDEBUG
+  std::thread::id owner_;
+#endif
+};
+
+/// Receive buffer for stream::read() backed by a buffer_pool. resize()
+/// leaves new bytes uninitialized, and a read response is dropped by moving
+/// the start of the buffer forward instead of the bytes after it, so the
+/// next reads land in the free space at the tail. Bytes move only when the
+/// tail runs out, to the front of the same block or to a block of the next
+/// size class.
+///
+/// A buffer created without a pool allocates its blocks itself and may move
+/// between threads with its stream. One created with a pool has to stay on
+/// the thread of the pool, which must outlive it.
+class receive_buffer {
+ public:
+  receive_buffer() noexcept = default;
+  explicit receive_buffer(buffer_pool& pool) noexcept : pool_{&pool} {}
+  receive_buffer(receive_buffer&& other) noexcept
+      : pool_{other.pool_},
+        block_{std::exchange(other.block_, {})},
+        head_{std::exchange(other.head_, 0)},
+        size_{std::exchange(other.size_, 0)} {}
+  receive_buffer& operator=(receive_buffer&& other) noexcept {
+    if (this != &other) {
+      release();
+      pool_ = other.pool_;
+      block_ = std::exchange(other.block_, {});
+      head_ = std::exchange(other.head_, 0);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+  ~receive_buffer() { release(); }
+
+  uint8_t* data() noexcept { return block_.data() + head_; }
+  const uint8_t* data() const noexcept { return block_.data() + head_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  uint8_t* begin() noexcept { return data(); }
+  uint8_t* end() noexcept { return data() + size_; }
+  const uint8_t* begin() const noexcept { return data(); }
+  const uint8_t* end() const noexcept { return data() + size_; }
+
+  /// Bytes the buffer can hold without moving its contents
+  size_t capacity() const noexcept { return block_.size() - head_; }
+
+  /// Sets the size, new bytes are left uninitialized.
+  void resize(size_t size) {
+    if (size > capacity()) {
+      grow(size);
+    }
+    size_ = size;
+  }
+
+  /// Drops the first `size` bytes without moving the rest.
+  void consume(size_t size) noexcept {
+    size = std::min(size, size_);
+    head_ += size;
+    size_ -= size;
+    if (size_ == 0) {
+      head_ = 0;
+    }
+  }
+
+  void clear() noexcept { head_ = size_ = 0; }
+
+  /// Hands the block back to the pool.
+  void release() noexcept {
+    deallocate(std::exchange(block_, {}));
+    head_ = size_ = 0;
+  }
+
+ private:
+  std::span<uint8_t> allocate(size_t size) {
+    if (pool_ != nullptr) {
+      return pool_->acquire(size);
+    }
+    auto block = buffer_pool::block_size(size);
+    return {new uint8_t[block], block};
+  }
+  void deallocate(std::span<uint8_t> block) noexcept {
+    if (pool_ != nullptr) {
+      pool_->release(block);
+    } else {
+      delete[] block.data();
+    }
+  }
+
+  void grow(size_t size) {
+    if (size <= block_.size()) {
+      std::memmove(block_.data(), data(), size_);
+      head_ = 0;
+      return;
+    }
+    auto block = allocate(size);
+    if (size_ != 0) {
+      std::memcpy(block.data(), data(), size_);
+    }
+    deallocate(std::exchange(block_, block));
+    head_ = 0;
+  }
+
+  buffer_pool* pool_{};
+  std::span<uint8_t> block_;
+  size_t head_{};
+  size_t size_{};
+};
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_BUFFER_POOL_HPP
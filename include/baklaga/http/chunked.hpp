@@ -0,0 +1,350 @@
+#ifndef BAKLAGA_HTTP_CHUNKED_HPP
+#define BAKLAGA_HTTP_CHUNKED_HPP
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "baklaga/http/concept/buffer.hpp"
+#include "baklaga/http/detail/message.hpp"
+#include "baklaga/http/detail/scan.hpp"
+
+namespace baklaga::http {
+using detail::parse_event_t;
+
+/// Incremental decoder of the chunked transfer coding (RFC 9112 7.1).
+/// Input may be split at any byte; chunk extensions are checked and
+/// skipped, and only trailer lines that straddle two inputs are copied.
+/// Chunk-size lines and chunk data have to end with CRLF, a bare CR or LF
+/// there is an error, as is a chunk-size line longer than max_line.
+/// Payload is reported in place, so a body of any size passes through
+/// without being gathered.
+class chunked_decoder {
+ public:
+  /// Longest chunk-size line (including extensions) or trailer line
+  static constexpr size_t max_line = 1024;
+
+  chunked_decoder() = default;
+
+  /// Consumes `input` until one event is ready: body (see data()), trailer
+  /// (see trailer()), done, error or need_more. `consumed` receives the
+  /// number of bytes used, views stay valid until the next call.
+  parse_event_t next(std::string_view input, size_t& consumed) {
+    size_t pos{};
+    auto result = [&](parse_event_t event) {
+      consumed = pos;
+      return event;
+    };
+
+    while (pos < input.size()) {
+      const char c = input[pos];
+      switch (state_) {
+        case state_t::size:
+          // The first byte that is not a digit is counted by size_end
+          if (auto digit = hex_digit(c); digit >= 0) {
+            if (++line_size_ > max_line) {
+              return result(set_error(std::errc::message_size));
+            }
+            if (size_ > (std::numeric_limits<uint64_t>::max() >> 4)) {
+              return result(set_error(std::errc::value_too_large));
+            }
+            size_ = (size_ << 4) | static_cast<uint64_t>(digit);
+            has_digits_ = true;
+            ++pos;
+            break;
+          }
+          if (!has_digits_) {
+            return result(set_error(std::errc::bad_message));
+          }
+          state_ = state_t::size_end;
+          break;
+        case state_t::size_end:
+          // BWS, then either a chunk-ext or the CR that ends the line
+          ++pos;
+          if (c == '\r') {
+            state_ = state_t::size_lf;
+          } else if (++line_size_ > max_line) {
+            return result(set_error(std::errc::message_size));
+          } else if (c == ';') {
+            state_ = state_t::extension;
+          } else if (c != ' ' && c != '\t') {
+            return result(set_error(std::errc::bad_message));
+          }
+          break;
+        case state_t::extension: {
+          // chunk-ext is not interpreted, only checked for control
+          // characters up to the CR that ends the line
+          auto end = pos;
+          while (end < input.size() && is_extension_char(input[end])) {
+            ++end;
+          }
+          line_size_ += end - pos;
+          pos = end;
+          if (line_size_ > max_line) {
+            return result(set_error(std::errc::message_size));
+          }
+          if (pos < input.size()) {
+            if (input[pos] != '\r') {
+              return result(set_error(std::errc::bad_message));
+            }
+            ++pos;
+            state_ = state_t::size_lf;
+          }
+          break;
+        }
+        case state_t::size_lf:
+          if (c != '\n') {
+            return result(set_error(std::errc::bad_message));
+          }
+          ++pos;
+          has_digits_ = false;
+          line_size_ = 0;
+          if (size_ == 0) {
+            state_ = state_t::trailer;
+          } else {
+            remaining_ = size_;
+            state_ = state_t::data;
+          }
+          break;
+        case state_t::data: {
+          auto size = static_cast<size_t>(
+              std::min<uint64_t>(remaining_, input.size() - pos));
+          data_ = input.substr(pos, size);
+          pos += size;
+          remaining_ -= size;
+          if (remaining_ == 0) {
+            state_ = state_t::data_cr;
+          }
+          return result(parse_event_t::body);
+        }
+        case state_t::data_cr:
+        case state_t::data_lf:
+          // Chunk data ends with exactly CRLF
+          if (c != (state_ == state_t::data_cr ? '\r' : '\n')) {
+            return result(set_error(std::errc::bad_message));
+          }
+          ++pos;
+          if (state_ == state_t::data_cr) {
+            state_ = state_t::data_lf;
+          } else {
+            size_ = 0;
+            state_ = state_t::size;
+          }
+          break;
+        case state_t::trailer: {
+          auto event = next_trailer(input, pos);
+          if (event != parse_event_t::need_more) {
+            return result(event);
+          }
+          break;
+        }
+        case state_t::done:
+          return result(parse_event_t::done);
+        case state_t::error:
+          return result(parse_event_t::error);
+      }
+    }
+
+    if (state_ == state_t::done) {
+      return result(parse_event_t::done);
+    }
+    return result(parse_event_t::need_more);
+  }
+
+  /// Decodes as much of `input` as possible, passing payload to `on_data`
+  /// and trailer fields to `on_trailer`. Returns the number of bytes
+  /// consumed, which is less than input.size() only after the last chunk.
+  template <typename DataFn, typename TrailerFn>
+  size_t decode(std::string_view input, DataFn&& on_data,
+                TrailerFn&& on_trailer) {
+    size_t total{};
+    for (;;) {
+      size_t consumed{};
+      auto event = next(input.substr(total), consumed);
+      total += consumed;
+      switch (event) {
+        case parse_event_t::body:
+          on_data(data_);
+          break;
+        case parse_event_t::trailer:
+          on_trailer(trailer_.first, trailer_.second);
+          break;
+        default:
+          return total;
+      }
+    }
+  }
+
+  template <typename DataFn>
+  size_t decode(std::string_view input, DataFn&& on_data) {
+    return decode(input, std::forward<DataFn>(on_data),
+                  [](std::string_view, std::string_view) {});
+  }
+
+  void reset() noexcept { *this = chunked_decoder{}; }
+
+  /// Payload bytes of the current chunk not passed to next() yet, zero
+  /// outside of chunk data
+  uint64_t pending_data() const noexcept {
+    return state_ == state_t::data ? remaining_ : 0;
+  }
+  /// Accounts for `size` payload bytes of the current chunk that were moved
+  /// elsewhere without passing through next(), at most pending_data().
+  void skip_data(uint64_t size) noexcept {
+    remaining_ -= size;
+    if (remaining_ == 0) {
+      state_ = state_t::data_cr;
+    }
+  }
+
+  auto data() const noexcept { return data_; }
+  const auto& trailer() const noexcept { return trailer_; }
+  bool done() const noexcept { return state_ == state_t::done; }
+  const auto& error() const noexcept { return error_; }
+
+ private:
+  enum class state_t : uint8_t {
+    size,
+    size_end,
+    extension,
+    size_lf,
+    data,
+    data_cr,
+    data_lf,
+    trailer,
+    done,
+    error
+  };
+
+  static constexpr int hex_digit(char c) noexcept {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  }
+
+  /// chunk-ext bytes: tokens, quoted strings and whitespace, so anything
+  /// but control characters
+  static constexpr bool is_extension_char(char c) noexcept {
+    auto byte = static_cast<unsigned char>(c);
+    return (byte >= 0x20 && byte != 0x7f) || c == '\t';
+  }
+
+  parse_event_t next_trailer(std::string_view input, size_t& pos) {
+    auto lf = input.find('\n', pos);
+    auto end = lf == std::string_view::npos ? input.size() : lf;
+
+    std::string_view line;
+    if (line_size_ == 0 && lf != std::string_view::npos) {
+      line = input.substr(pos, end - pos);
+    } else {
+      if (line_size_ + (end - pos) > line_.size()) {
+        return set_error(std::errc::message_size);
+      }
+      std::copy(input.begin() + pos, input.begin() + end,
+                line_.begin() + line_size_);
+      line_size_ += end - pos;
+      line = {line_.data(), line_size_};
+    }
+
+    if (lf == std::string_view::npos) {
+      pos = input.size();
+      return parse_event_t::need_more;
+    }
+    pos = lf + 1;
+    line_size_ = 0;
+
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      state_ = state_t::done;
+      return parse_event_t::done;
+    }
+
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0) {
+      return set_error(std::errc::bad_message);
+    }
+    trailer_ = {line.substr(0, colon),
+                detail::trim_ows(line.substr(colon + 1))};
+    return parse_event_t::trailer;
+  }
+
+  parse_event_t set_error(std::errc code) noexcept {
+    error_ = std::make_error_code(code);
+    state_ = state_t::error;
+    return parse_event_t::error;
+  }
+
+  state_t state_{state_t::size};
+  bool has_digits_{};
+  uint64_t size_{};
+  uint64_t remaining_{};
+  std::string_view data_;
+  std::pair<std::string_view, std::string_view> trailer_;
+  size_t line_size_{};
+  // Zeroed, so resetting a decoder never copies indeterminate bytes
+  std::array<char, max_line> line_{};
+  std::error_code error_;
+};
+
+/// Produces the framing of the chunked transfer coding around payload that
+/// stays in caller storage: chunk_header(size), the payload, chunk_end.
+class chunked_encoder {
+ public:
+  static constexpr std::string_view chunk_end = "\r\n";
+  static constexpr std::string_view last_chunk = "0\r\n\r\n";
+
+  /// Returns "<hex size>\r\n", valid until the next call.
+  std::string_view chunk_header(size_t size) noexcept {
+    auto [end, _] =
+        std::to_chars(header_.data(), header_.data() + header_.size() - 2,
+                      size, 16);
+    *end++ = '\r';
+    *end++ = '\n';
+    return {header_.data(), static_cast<size_t>(end - header_.data())};
+  }
+
+  /// Appends one complete chunk to `buffer`. Empty payload is skipped,
+  /// since a zero-sized chunk would end the body.
+  template <concept_::ReadBuffer BufferTy>
+  void append_chunk(BufferTy& buffer, std::string_view payload) {
+    if (payload.empty()) {
+      return;
+    }
+    auto header = chunk_header(payload.size());
+    append(buffer, header);
+    append(buffer, payload);
+    append(buffer, chunk_end);
+  }
+
+  template <concept_::ReadBuffer BufferTy>
+  void append_last_chunk(BufferTy& buffer) {
+    append(buffer, last_chunk);
+  }
+
+ private:
+  template <concept_::ReadBuffer BufferTy>
+  static void append(BufferTy& buffer, std::string_view str) {
+    auto offset = std::ranges::size(buffer);
+    buffer.resize(offset + str.size());
+    std::memcpy(reinterpret_cast<char*>(std::ranges::data(buffer)) + offset,
+                str.data(), str.size());
+  }
+
+  std::array<char, 2 * sizeof(size_t) + 2> header_;
+};
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_CHUNKED_HPP
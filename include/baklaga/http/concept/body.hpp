@@ -0,0 +1,31 @@
+#ifndef BAKLAGA_HTTP_BODY_CONCEPT_HPP
+#define BAKLAGA_HTTP_BODY_CONCEPT_HPP
+
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+namespace baklaga::http::concept_ {
+/// A request body pulled by stream::write() piece by piece. size() is the
+/// total length if known up front, read() returns the next piece (valid
+/// until the next call) and an empty view at the end.
+template <class Body>
+concept body_source =
+    requires(Body b, const Body cb, std::error_code& error) {
+      { cb.size() } -> std::same_as<std::optional<uint64_t>>;
+      { b.read(error) } -> std::same_as<std::string_view>;
+    };
+
+/// Optional capability: the body can send itself to a socket descriptor in
+/// the kernel (sendfile), used with a concept_::direct_io_socket. transfer()
+/// returns the number of bytes sent, zero once the body is complete.
+template <class Body>
+concept direct_body =
+    body_source<Body> && requires(Body b, int socket, std::error_code& error) {
+      { b.transfer(socket, error) } -> std::same_as<uint64_t>;
+    };
+}  // namespace baklaga::http::concept_
+
+#endif  // BAKLAGA_HTTP_BODY_CONCEPT_HPP
@@ -1,6 +1,8 @@
 #ifndef BAKLAGA_HTTP_CONCEPT_BUFFER_HPP
 #define BAKLAGA_HTTP_CONCEPT_BUFFER_HPP
 
+#include <concepts>
+#include <cstddef>
 #include <ranges>
 
 namespace baklaga::http::concept_ {
@@ -8,6 +10,14 @@ template <typename Ty>
 concept ReadBuffer = std::ranges::contiguous_range<Ty> && requires(Ty buf) {
   { buf.resize(size_t{}) } -> std::same_as<void>;
 };
+
+/// A ReadBuffer that drops bytes from its front without moving the rest and
+/// has room behind its end, see receive_buffer.
+template <typename Ty>
+concept ConsumableBuffer = ReadBuffer<Ty> && requires(Ty buf) {
+  buf.consume(size_t{});
+  { buf.capacity() } -> std::convertible_to<size_t>;
+};
 }  // namespace baklaga::http::concept_
 
 #endif  // BAKLAGA_HTTP_CONCEPT_BUFFER_HPP
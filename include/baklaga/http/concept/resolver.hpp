@@ -0,0 +1,22 @@
+#ifndef BAKLAGA_HTTP_RESOLVER_CONCEPT_HPP
+#define BAKLAGA_HTTP_RESOLVER_CONCEPT_HPP
+
+#include <concepts>
+#include <string_view>
+#include <system_error>
+
+namespace baklaga::http {
+class resolution;
+}  // namespace baklaga::http
+
+namespace baklaga::http::concept_ {
+/// Turns a host name into addresses; stream and async_stream connect to
+/// them instead of letting the socket resolve. Shared resolvers (see
+/// resolver_cache) are called from several threads at once.
+template <class Resolver>
+concept resolver = requires(Resolver r, std::error_code& error) {
+  { r.resolve(std::string_view{}, error) } -> std::same_as<resolution>;
+};
+}  // namespace baklaga::http::concept_
+
+#endif  // BAKLAGA_HTTP_RESOLVER_CONCEPT_HPP
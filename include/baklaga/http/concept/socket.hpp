@@ -1,13 +1,24 @@
 #ifndef BAKLAGA_HTTP_SOCKET_CONCEPT_HPP
 #define BAKLAGA_HTTP_SOCKET_CONCEPT_HPP
 
+#include <chrono>
 #include <concepts>
+#include <coroutine>
+#include <cstdint>
 #include <span>
 #include <string_view>
 #include <system_error>
 
 #include "baklaga/http/concept/buffer.hpp"
 
+namespace baklaga::http {
+/// A read-only piece of memory for vectored writes.
+using const_buffer = std::span<const uint8_t>;
+
+class address;
+class timer_wheel;
+}  // namespace baklaga::http
+
 namespace baklaga::http::concept_ {
 template <class Socket>
 concept socket = requires(Socket s, std::error_code& error) {
@@ -15,11 +26,110 @@ concept socket = requires(Socket s, std::error_code& error) {
   {
     s.connect(std::string_view{}, std::string_view{}, error)
   } -> std::same_as<void>;
-  { s.read(ReadBuffer<uint8_t>, error) } -> std::same_as<size_t>;
+  { s.read(std::span<uint8_t>{}, error) } -> std::same_as<size_t>;
   { s.write(std::span<const uint8_t>{}, error) } -> std::same_as<size_t>;
   { s.shutdown(error) } -> std::same_as<void>;
   { s.close(error) } -> std::same_as<void>;
 };
+
+/// Optional capability: writes a list of buffers with a single call
+/// (writev / WSASend / asio gather write). Returns the number of bytes
+/// written, which may end in the middle of any buffer.
+template <class Socket>
+concept vectored_socket =
+    socket<Socket> && requires(Socket s, std::error_code& error) {
+      {
+        s.write(std::span<const const_buffer>{}, error)
+      } -> std::same_as<size_t>;
+    };
+
+/// Optional capability: exposes the operating system descriptor, which
+/// the stream polls to enforce deadlines.
+template <class Socket>
+concept native_socket = socket<Socket> && requires(const Socket s) {
+  { s.native_handle() } -> std::convertible_to<int>;
+};
+
+/// Opt-in on top of native_socket: bytes pass between the socket and its
+/// descriptor unchanged, so bodies may bypass the socket and move between
+/// the descriptor and files in the kernel (see file_sink, file_body). A
+/// socket declares `static constexpr bool raw_descriptor = true;`; one
+/// that transforms the stream (e.g. TLS) must not, whatever descriptor it
+/// exposes.
+template <class Socket>
+concept direct_io_socket =
+    native_socket<Socket> && requires { requires Socket::raw_descriptor; };
+
+/// Optional capability: limits the following connect() calls to
+/// `timeout` (zero removes the limit), an expired one fails with
+/// std::errc::timed_out. The stream uses it for its connect deadline,
+/// since a socket may create its descriptor only in connect().
+template <class Socket>
+concept timed_connect_socket =
+    socket<Socket> && requires(Socket s, std::chrono::nanoseconds timeout) {
+      { s.connect_timeout(timeout) } -> std::same_as<void>;
+    };
+
+/// Optional capability: connects to an already resolved address, so the
+/// stream can use a resolver (see concept_::resolver) instead of the socket
+/// resolving the host itself.
+template <class Socket>
+concept address_socket =
+    socket<Socket> && requires(Socket s, const address& a,
+                               std::error_code& error) {
+      { s.connect(a, error) } -> std::same_as<void>;
+    };
+
+/// A body sink that can also take up to `size` body bytes straight from a
+/// socket descriptor; returns the number of bytes taken, zero at the end of
+/// the stream.
+template <class Sink>
+concept direct_sink = requires(Sink s, int socket, std::error_code& error) {
+  { s.transfer(socket, uint64_t{}, error) } -> std::same_as<uint64_t>;
+};
+
+/// An object that can be passed to co_await directly and produces `Ty`.
+template <class Awaiter, class Ty>
+concept awaiter_of = requires(Awaiter a, std::coroutine_handle<> handle) {
+  { a.await_ready() } -> std::convertible_to<bool>;
+  a.await_suspend(handle);
+  { a.await_resume() } -> std::same_as<Ty>;
+};
+
+/// Non-blocking counterpart of `socket`: connect, read and write return
+/// awaiters that complete once the operation is done, errors are stored
+/// in `error` like the blocking calls do.
+template <class Socket>
+concept async_socket = requires(Socket s, std::error_code& error) {
+  { s.open(error) } -> std::same_as<void>;
+  {
+    s.async_connect(std::string_view{}, std::string_view{}, error)
+  } -> awaiter_of<void>;
+  { s.async_read(std::span<uint8_t>{}, error) } -> awaiter_of<size_t>;
+  {
+    s.async_write(std::span<const uint8_t>{}, error)
+  } -> awaiter_of<size_t>;
+  { s.shutdown(error) } -> std::same_as<void>;
+  { s.close(error) } -> std::same_as<void>;
+};
+
+/// Coroutine counterpart of address_socket
+template <class Socket>
+concept async_address_socket =
+    async_socket<Socket> && requires(Socket s, const address& a,
+                                     std::error_code& error) {
+      { s.async_connect(a, error) } -> awaiter_of<void>;
+    };
+
+/// Optional capability of an async_socket: exposes the timer_wheel of its
+/// executor, and cancel(reason) completes the pending operations with
+/// `reason` and fails every later one with it until the next open().
+template <class Socket>
+concept cancellable_socket =
+    async_socket<Socket> && requires(Socket s, std::error_code reason) {
+      { s.timers() } -> std::same_as<timer_wheel&>;
+      { s.cancel(reason) } -> std::same_as<void>;
+    };
 }  // namespace baklaga::http::concept_
 
 #endif  // BAKLAGA_HTTP_SOCKET_CONCEPT_HPP
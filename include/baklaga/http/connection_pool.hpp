@@ -0,0 +1,265 @@
+#ifndef BAKLAGA_HTTP_CONNECTION_POOL_HPP
+#define BAKLAGA_HTTP_CONNECTION_POOL_HPP
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "baklaga/http/buffer_pool.hpp"
+#include "baklaga/http/concept/resolver.hpp"
+#include "baklaga/http/concept/socket.hpp"
+#include "baklaga/http/detail/string.hpp"
+#include "baklaga/http/stream.hpp"
+#include "baklaga/http/timer_wheel.hpp"
+#include "baklaga/http/uri.hpp"
+
+namespace baklaga::http {
+/// Keeps idle keep-alive connections per origin (scheme, host and port), so
+/// requests to the same server skip the TCP connect. A connection goes back
+/// to the pool only if its last response was read to the end, see
+/// stream::reusable(). An idle connection the server closed meanwhile is
+/// replaced by the stream on the next request, see stream::write().
+/// Receive buffers of the connections come from a buffer_pool owned by the
+/// pool. Not thread-safe, use one pool per thread and keep its connections
+/// on that thread.
+template <concept_::socket Socket>
+class connection_pool {
+ public:
+  using clock = std::chrono::steady_clock;
+  using stream_t = http::stream<Socket>;
+
+  struct options {
+    /// Idle and borrowed connections to one host
+    size_t max_per_host = 8;
+    /// Idle and borrowed connections to all hosts
+    size_t max_total = 64;
+    /// Idle connections older than this are closed
+    clock::duration idle_timeout = std::chrono::seconds{30};
+    /// Applied to every connection, see stream::deadlines() (Linux, sockets
+    /// with native_handle())
+    http::deadlines deadlines{};
+  };
+
+ private:
+  struct idle_t {
+    stream_t stream;
+    clock::time_point since;
+  };
+  struct host_t {
+    std::vector<idle_t> idle;  // oldest first
+    size_t active{};
+  };
+
+ public:
+  /// A borrowed connection, handed back to the pool when destroyed.
+  class connection {
+   public:
+    connection() = default;
+    connection(connection&& other) noexcept
+        : pool_{std::exchange(other.pool_, nullptr)},
+          host_{other.host_},
+          stream_{std::move(other.stream_)} {}
+    connection& operator=(connection&& other) noexcept {
+      if (this != &other) {
+        release();
+        pool_ = std::exchange(other.pool_, nullptr);
+        host_ = other.host_;
+        stream_ = std::move(other.stream_);
+      }
+      return *this;
+    }
+    ~connection() { release(); }
+
+    /// Hands the connection back early.
+    void release() {
+      if (pool_ != nullptr) {
+        std::exchange(pool_, nullptr)->release(*host_, std::move(*stream_));
+        stream_.reset();
+      }
+    }
+
+    explicit operator bool() const noexcept { return pool_ != nullptr; }
+    stream_t& operator*() noexcept { return *stream_; }
+    stream_t* operator->() noexcept { return &*stream_; }
+
+   private:
+    friend class connection_pool;
+
+    connection(connection_pool* pool, host_t* host, stream_t&& stream)
+        : pool_{pool}, host_{host}, stream_{std::move(stream)} {}
+
+    connection_pool* pool_{};
+    host_t* host_{};
+    // Empty in a default-constructed connection, so sockets without a
+    // default constructor (see `make_socket` of the pool) work as well
+    std::optional<stream_t> stream_;
+  };
+
+  connection_pool() = default;
+  explicit connection_pool(
+      options opts, std::function<Socket()> make_socket = [] {
+        return Socket{};
+      })
+      : options_{opts}, make_socket_{std::move(make_socket)} {}
+
+  connection_pool(const connection_pool&) = delete;
+  connection_pool& operator=(const connection_pool&) = delete;
+
+  /// Returns the most recently used idle connection to the origin of
+  /// `uri`, or connects a new one. Fails with resource_unavailable_try_again
+  /// if a limit is reached and no idle connection can be closed instead.
+  connection acquire(http::uri_view uri, std::error_code& ec) {
+    auto now = clock::now();
+    evict_idle(now);
+
+    auto& host = hosts_[key(uri)];
+    if (!host.idle.empty()) {
+      auto stream = std::move(host.idle.back().stream);
+      host.idle.pop_back();
+      --idle_;
+      ++host.active;
+      ++active_;
+      return connection{this, &host, std::move(stream)};
+    }
+
+    if (host.active >= options_.max_per_host ||
+        (active_ + idle_ >= options_.max_total && !evict_oldest())) {
+      ec = std::make_error_code(std::errc::resource_unavailable_try_again);
+      return {};
+    }
+
+    stream_t stream{make_socket_(), buffers_};
+    stream.keep_alive(true);
+#if defined(__linux__)
+    if constexpr (concept_::native_socket<Socket>) {
+      stream.deadlines(options_.deadlines);
+    }
+    if (use_resolver_) {
+      use_resolver_(stream);
+    }
+#endif
+    if (ec = stream.connect(uri); ec) {
+      stream.shutdown();
+      return {};
+    }
+    ++host.active;
+    ++active_;
+    return connection{this, &host, std::move(stream)};
+  }
+
+  /// Closes idle connections that were not used since `now - idle_timeout`.
+  void evict_idle(clock::time_point now = clock::now()) {
+    for (auto it = hosts_.begin(); it != hosts_.end();) {
+      auto& idle = it->second.idle;
+      auto expired = idle.begin();
+      while (expired != idle.end() &&
+             now - expired->since >= options_.idle_timeout) {
+        expired->stream.shutdown();
+        ++expired;
+      }
+      idle_ -= static_cast<size_t>(expired - idle.begin());
+      idle.erase(idle.begin(), expired);
+
+      if (idle.empty() && it->second.active == 0) {
+        it = hosts_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /// Closes every idle connection, borrowed ones are closed when returned.
+  void clear() { evict_idle(clock::time_point::max()); }
+
+#if defined(__linux__)
+  /// New connections resolve their host with `r`, see stream::resolver().
+  template <concept_::resolver ResolverTy>
+    requires concept_::address_socket<Socket>
+  void resolver(ResolverTy& r) {
+    use_resolver_ = [&r](stream_t& stream) { stream.resolver(r); };
+  }
+#endif
+
+  size_t idle_count() const noexcept { return idle_; }
+  size_t active_count() const noexcept { return active_; }
+
+ private:
+  /// "scheme://host:port", so e.g. http and https connections to the same
+  /// port are never mixed up
+  static std::string key(http::uri_view uri) {
+    auto scheme = uri.scheme();
+    auto hostname = uri.authority().hostname();
+    std::array<char, 8> port{};
+    auto [port_end, _] =
+        std::to_chars(port.data(), port.data() + port.size(), uri.port());
+
+    std::string result;
+    result.reserve(scheme.size() + 3 + hostname.size() + 1 +
+                   (port_end - port.data()));
+    // Schemes and host names are case-insensitive
+    for (auto c : scheme) {
+      result.push_back(detail::to_lower(c));
+    }
+    result.append("://");
+    for (auto c : hostname) {
+      result.push_back(detail::to_lower(c));
+    }
+    result.push_back(':');
+    result.append(port.data(), port_end);
+    return result;
+  }
+
+  void release(host_t& host, stream_t&& stream) {
+    --host.active;
+    --active_;
+    if (!stream.reusable() || host.idle.size() >= options_.max_per_host) {
+      stream.shutdown();
+      return;
+    }
+    host.idle.push_back({std::move(stream), clock::now()});
+    ++idle_;
+  }
+
+  /// Makes room under max_total by closing the least recently used idle
+  /// connection of any host.
+  bool evict_oldest() {
+    host_t* oldest{};
+    for (auto& [_, host] : hosts_) {
+      if (!host.idle.empty() &&
+          (oldest == nullptr ||
+           host.idle.front().since < oldest->idle.front().since)) {
+        oldest = &host;
+      }
+    }
+    if (oldest == nullptr) {
+      return false;
+    }
+    oldest->idle.front().stream.shutdown();
+    oldest->idle.erase(oldest->idle.begin());
+    --idle_;
+    return true;
+  }
+
+  options options_{};
+  std::function<Socket()> make_socket_{[] { return Socket{}; }};
+  // Outlives the idle connections below
+  buffer_pool buffers_;
+  std::unordered_map<std::string, host_t> hosts_;
+#if defined(__linux__)
+  std::function<void(stream_t&)> use_resolver_;
+#endif
+  size_t active_{};
+  size_t idle_{};
+};
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_CONNECTION_POOL_HPP
@@ -0,0 +1,77 @@
+#ifndef BAKLAGA_HTTP_DETAIL_BUFFER_HPP
+#define BAKLAGA_HTTP_DETAIL_BUFFER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ranges>
+#include <span>
+#include <string_view>
+
+#include "baklaga/http/concept/buffer.hpp"
+#include "baklaga/http/concept/socket.hpp"
+
+namespace baklaga::http::detail {
+[[nodiscard]] inline const_buffer as_bytes(std::string_view str) noexcept {
+  return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+/// The first `size` bytes of `buffer` as characters
+template <concept_::ReadBuffer BufferTy>
+[[nodiscard]] std::string_view as_view(const BufferTy& buffer, size_t size) {
+  return {reinterpret_cast<const char*>(std::ranges::data(buffer)), size};
+}
+
+/// Grows `buffer` so at least `size` bytes can be received after the first
+/// `received` ones and returns that space. A ConsumableBuffer offers all of
+/// its free tail, since growing it does not fill anything.
+template <concept_::ReadBuffer BufferTy>
+[[nodiscard]] std::span<uint8_t> receive_space(BufferTy& buffer,
+                                               size_t received, size_t size) {
+  if constexpr (concept_::ConsumableBuffer<BufferTy>) {
+    size = std::max(size, buffer.capacity() - received);
+  }
+  buffer.resize(received + size);
+  return {reinterpret_cast<uint8_t*>(std::ranges::data(buffer)) + received,
+          size};
+}
+
+/// Remembers where the last response ended, so a stream can drop it from
+/// the buffer when the next read starts with the very same buffer.
+class receive_cursor {
+ public:
+  /// Removes the previous response from `buffer` unless the caller changed
+  /// the buffer since. Bytes after its end move to the front, unless the
+  /// buffer can consume its front in place.
+  template <concept_::ReadBuffer BufferTy>
+  void drop(BufferTy& buffer) {
+    auto size = std::ranges::size(buffer);
+    if (consumed_ == 0 || buffer_ != std::ranges::data(buffer) ||
+        size_ != size) {
+      // changed by the caller, keep it as is
+    } else if constexpr (concept_::ConsumableBuffer<BufferTy>) {
+      buffer.consume(consumed_);
+    } else {
+      auto* data = reinterpret_cast<char*>(std::ranges::data(buffer));
+      std::memmove(data, data + consumed_, size - consumed_);
+      buffer.resize(size - consumed_);
+    }
+    consumed_ = 0;
+  }
+
+  /// Records that the first `size` bytes of `buffer` hold a read response.
+  template <concept_::ReadBuffer BufferTy>
+  void consumed(const BufferTy& buffer, size_t size) noexcept {
+    buffer_ = std::ranges::data(buffer);
+    size_ = std::ranges::size(buffer);
+    consumed_ = size;
+  }
+
+ private:
+  const void* buffer_{};
+  size_t size_{};
+  size_t consumed_{};
+};
+}  // namespace baklaga::http::detail
+
+#endif  // BAKLAGA_HTTP_DETAIL_BUFFER_HPP
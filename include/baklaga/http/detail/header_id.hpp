@@ -0,0 +1,204 @@
+#ifndef BAKLAGA_HTTP_DETAIL_HEADER_ID_HPP
+#define BAKLAGA_HTTP_DETAIL_HEADER_ID_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "baklaga/http/detail/string.hpp"
+
+namespace baklaga::http::detail {
+enum class header_id_t : uint8_t {
+  unknown,
+  accept,
+  accept_encoding,
+  accept_language,
+  age,
+  allow,
+  authorization,
+  cache_control,
+  connection,
+  content_encoding,
+  content_length,
+  content_type,
+  cookie,
+  date,
+  etag,
+  expect,
+  host,
+  if_modified_since,
+  if_none_match,
+  keep_alive,
+  last_modified,
+  location,
+  origin,
+  range,
+  referer,
+  server,
+  set_cookie,
+  te,
+  trailer,
+  transfer_encoding,
+  upgrade,
+  user_agent,
+  vary,
+  via,
+  www_authenticate,
+  count_
+};
+
+constexpr size_t header_id_count = static_cast<size_t>(header_id_t::count_);
+
+constexpr auto header_id_names = std::to_array<std::string_view>(
+    {{},
+     "Accept",
+     "Accept-Encoding",
+     "Accept-Language",
+     "Age",
+     "Allow",
+     "Authorization",
+     "Cache-Control",
+     "Connection",
+     "Content-Encoding",
+     "Content-Length",
+     "Content-Type",
+     "Cookie",
+     "Date",
+     "ETag",
+     "Expect",
+     "Host",
+     "If-Modified-Since",
+     "If-None-Match",
+     "Keep-Alive",
+     "Last-Modified",
+     "Location",
+     "Origin",
+     "Range",
+     "Referer",
+     "Server",
+     "Set-Cookie",
+     "TE",
+     "Trailer",
+     "Transfer-Encoding",
+     "Upgrade",
+     "User-Agent",
+     "Vary",
+     "Via",
+     "WWW-Authenticate"});
+static_assert(header_id_names.size() == header_id_count);
+
+constexpr std::string_view from_header_id(header_id_t id) noexcept {
+  auto index = static_cast<size_t>(id);
+  return index < header_id_count ? header_id_names[index] : std::string_view{};
+}
+
+/// Interns a header name: the length and the first letter select at most one
+/// candidate, so only a single case-insensitive comparison is made.
+constexpr header_id_t to_header_id(std::string_view name) noexcept {
+  using enum header_id_t;
+
+  auto is = [name](header_id_t id) {
+    return iequals(name, from_header_id(id)) ? id : unknown;
+  };
+
+  if (name.empty()) {
+    return unknown;
+  }
+  const char first = to_lower(name.front());
+  switch (name.size()) {
+    case 2:
+      return is(te);
+    case 3:
+      return is(first == 'a' ? age : via);
+    case 4:
+      switch (first) {
+        case 'd':
+          return is(date);
+        case 'e':
+          return is(etag);
+        case 'h':
+          return is(host);
+        case 'v':
+          return is(vary);
+      }
+      break;
+    case 5:
+      return is(first == 'a' ? allow : range);
+    case 6:
+      switch (first) {
+        case 'a':
+          return is(accept);
+        case 'c':
+          return is(cookie);
+        case 'e':
+          return is(expect);
+        case 'o':
+          return is(origin);
+        case 's':
+          return is(server);
+      }
+      break;
+    case 7:
+      switch (first) {
+        case 'r':
+          return is(referer);
+        case 't':
+          return is(trailer);
+        case 'u':
+          return is(upgrade);
+      }
+      break;
+    case 8:
+      return is(location);
+    case 10:
+      switch (first) {
+        case 'c':
+          return is(connection);
+        case 'k':
+          return is(keep_alive);
+        case 's':
+          return is(set_cookie);
+        case 'u':
+          return is(user_agent);
+      }
+      break;
+    case 12:
+      return is(content_type);
+    case 13:
+      switch (first) {
+        case 'a':
+          return is(authorization);
+        case 'c':
+          return is(cache_control);
+        case 'i':
+          return is(if_none_match);
+        case 'l':
+          return is(last_modified);
+      }
+      break;
+    case 14:
+      return is(content_length);
+    case 15:
+      // accept-encoding / accept-language differ at the 8th letter
+      return is(to_lower(name[7]) == 'e' ? accept_encoding : accept_language);
+    case 16:
+      return is(first == 'c' ? content_encoding : www_authenticate);
+    case 17:
+      return is(first == 'i' ? if_modified_since : transfer_encoding);
+  }
+  return unknown;
+}
+
+static_assert([] {
+  for (size_t i = 1; i < header_id_count; ++i) {
+    auto id = static_cast<header_id_t>(i);
+    if (to_header_id(from_header_id(id)) != id) {
+      return false;
+    }
+  }
+  return true;
+}());
+}  // namespace baklaga::http::detail
+
+#endif  // BAKLAGA_HTTP_DETAIL_HEADER_ID_HPP
@@ -0,0 +1,210 @@
+#ifndef BAKLAGA_HTTP_DETAIL_HEADERS_HPP
+#define BAKLAGA_HTTP_DETAIL_HEADERS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "baklaga/http/detail/header_id.hpp"
+#include "baklaga/http/detail/string.hpp"
+
+namespace baklaga::http::detail {
+/// Header fields in receive order. The first N fields are stored inline, so
+/// a typical message is parsed without touching the heap; larger messages
+/// spill into a vector. Names are compared case-insensitively and the same
+/// name may occur several times (Set-Cookie). The first field of every
+/// well-known name is indexed by its header_id_t for O(1) lookups.
+template <typename Ty, size_t N = 24>
+class basic_headers {
+ public:
+  using value_type = std::pair<Ty, Ty>;
+  using iterator = value_type*;
+  using const_iterator = const value_type*;
+
+  basic_headers() = default;
+  basic_headers(std::initializer_list<value_type> fields) {
+    for (const auto& [name, content] : fields) {
+      emplace(name, content);
+    }
+  }
+
+  /// Appends a field, even if a field with the same name already exists.
+  template <typename NameTy, typename ContentTy>
+  iterator emplace(NameTy&& name, ContentTy&& content) {
+    if constexpr (std::is_same_v<std::decay_t<NameTy>, header_id_t>) {
+      return emplace(name, from_header_id(name),
+                     std::forward<ContentTy>(content));
+    } else {
+      auto id = to_header_id(name);
+      return emplace(id, std::forward<NameTy>(name),
+                     std::forward<ContentTy>(content));
+    }
+  }
+
+  /// Appends a field whose name is already interned, e.g. by the parser.
+  template <typename NameTy, typename ContentTy>
+  iterator emplace(header_id_t id, NameTy&& name, ContentTy&& content) {
+    auto position = size();
+    iterator field{};
+    if (heap_.empty() && size_ < N) {
+      field = &inline_[size_++];
+      field->first = Ty(std::forward<NameTy>(name));
+      field->second = Ty(std::forward<ContentTy>(content));
+    } else {
+      if (heap_.empty()) {
+        heap_.reserve(N * 2);
+        std::ranges::move(inline_.begin(), inline_.begin() + size_,
+                          std::back_inserter(heap_));
+        size_ = 0;
+      }
+      field = &heap_.emplace_back(Ty(std::forward<NameTy>(name)),
+                                  Ty(std::forward<ContentTy>(content)));
+    }
+
+    if (id != header_id_t::unknown && index(id) == 0) {
+      index(id) = static_cast<uint32_t>(position + 1);
+    }
+    return field;
+  }
+
+  /// Appends a field only if there is no field with the same name yet.
+  template <typename NameTy, typename ContentTy>
+  std::pair<iterator, bool> try_emplace(NameTy&& name, ContentTy&& content) {
+    if (auto it = find(name); it != end()) {
+      return {it, false};
+    }
+    return {emplace(name, std::forward<ContentTy>(content)), true};
+  }
+
+  /// Replaces the first field with the same name or appends a new one.
+  template <typename NameTy, typename ContentTy>
+  iterator insert_or_assign(NameTy&& name, ContentTy&& content) {
+    if (auto it = find(name); it != end()) {
+      it->second = Ty(std::forward<ContentTy>(content));
+      return it;
+    }
+    return emplace(name, std::forward<ContentTy>(content));
+  }
+
+  Ty& operator[](std::string_view name) {
+    if (auto it = find(name); it != end()) {
+      return it->second;
+    }
+    return emplace(name, Ty{})->second;
+  }
+
+  /// Removes every field with the given name.
+  size_t erase(std::string_view name) {
+    auto removed = std::ranges::remove_if(begin(), end(), named(name));
+    auto count = static_cast<size_t>(removed.size());
+    if (heap_.empty()) {
+      size_ -= count;
+    } else {
+      heap_.resize(heap_.size() - count);
+    }
+
+    if (count != 0) {
+      index_.fill(0);
+      for (size_t i = size(); i-- > 0;) {
+        auto id = to_header_id(data()[i].first);
+        if (id != header_id_t::unknown) {
+          index(id) = static_cast<uint32_t>(i + 1);
+        }
+      }
+    }
+    return count;
+  }
+  size_t erase(header_id_t id) { return erase(from_header_id(id)); }
+
+  void clear() noexcept {
+    size_ = 0;
+    heap_.clear();
+    index_.fill(0);
+  }
+
+  /// Well-known names are looked up through the index, others are scanned.
+  iterator find(std::string_view name) noexcept {
+    if (auto id = to_header_id(name); id != header_id_t::unknown) {
+      return find(id);
+    }
+    return std::ranges::find_if(begin(), end(), named(name));
+  }
+  const_iterator find(std::string_view name) const noexcept {
+    return const_cast<basic_headers*>(this)->find(name);
+  }
+  iterator find(header_id_t id) noexcept {
+    if (id == header_id_t::unknown || id >= header_id_t::count_) {
+      return end();
+    }
+    auto position = index(id);
+    return position == 0 ? end() : begin() + (position - 1);
+  }
+  const_iterator find(header_id_t id) const noexcept {
+    return const_cast<basic_headers*>(this)->find(id);
+  }
+
+  template <typename NameTy>
+  const Ty& at(const NameTy& name) const {
+    auto it = find(name);
+    if (it == end()) {
+      throw std::out_of_range{"baklaga::http: no such header"};
+    }
+    return it->second;
+  }
+
+  template <typename NameTy>
+  bool contains(const NameTy& name) const noexcept {
+    return find(name) != end();
+  }
+  size_t count(std::string_view name) const noexcept {
+    return static_cast<size_t>(
+        std::ranges::count_if(begin(), end(), named(name)));
+  }
+
+  /// Lazily yields every value of the fields with the given name.
+  auto values(std::string_view name) const {
+    return std::ranges::subrange(begin(), end()) |
+           std::views::filter(named(name)) |
+           std::views::values;
+  }
+
+  iterator begin() noexcept { return data(); }
+  iterator end() noexcept { return data() + size(); }
+  const_iterator begin() const noexcept { return data(); }
+  const_iterator end() const noexcept { return data() + size(); }
+  size_t size() const noexcept { return heap_.empty() ? size_ : heap_.size(); }
+  bool empty() const noexcept { return size() == 0; }
+
+ private:
+  uint32_t& index(header_id_t id) noexcept {
+    return index_[static_cast<size_t>(id)];
+  }
+
+  static auto named(std::string_view name) noexcept {
+    return [name](const value_type& f) { return iequals(f.first, name); };
+  }
+
+  value_type* data() noexcept {
+    return heap_.empty() ? inline_.data() : heap_.data();
+  }
+  const value_type* data() const noexcept {
+    return heap_.empty() ? inline_.data() : heap_.data();
+  }
+
+  std::array<value_type, N> inline_{};
+  size_t size_{};
+  std::vector<value_type> heap_;
+  std::array<uint32_t, header_id_count> index_{};
+};
+}  // namespace baklaga::http::detail
+
+#endif  // BAKLAGA_HTTP_DETAIL_HEADERS_HPP
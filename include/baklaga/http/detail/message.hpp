@@ -1,20 +1,55 @@
 #ifndef BAKLAGA_HTTP_DETAIL_MESSAGE_HPP
 #define BAKLAGA_HTTP_DETAIL_MESSAGE_HPP
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <limits>
 #include <string_view>
-#include <unordered_map>
 
+#include "baklaga/http/detail/headers.hpp"
 #include "baklaga/http/detail/string.hpp"
 
 namespace baklaga::http::detail {
 
 [[maybe_unused]] constexpr std::string_view crlf_delimiter = "\r\n";
 
-enum class method_t : uint8_t { get, post, put, delete_ };
+enum class message_t { request, response };
+
+enum class parse_event_t : uint8_t {
+  need_more,     // every received byte is consumed, feed more data
+  start_line,    // start line is parsed, see method()/target()/status_code()
+  header,        // a header field is parsed, see header()
+  headers_done,  // empty line after the header block is reached
+  body,          // a part of the body is available, see body()
+  trailer,       // a trailer field of a chunked body is parsed
+  done,          // the whole message is received
+  error          // the message is malformed, see error()
+};
+
+/// How the end of a message body is found (RFC 9112 6.3).
+enum class body_framing_t : uint8_t {
+  none,     // no body: HEAD responses, 1xx/204/304, requests without length
+  length,   // Content-Length bytes
+  chunked,  // chunked transfer coding
+  close     // response body ends when the connection is closed
+};
+
+enum class method_t : uint8_t {
+  get,
+  post,
+  put,
+  delete_,
+  head,
+  options,
+  patch,
+  connect,
+  trace,
+  extension  // any other token, the name is carried next to the value
+};
+
+using headers_t = basic_headers<std::string_view>;
 
-using headers_t = std::unordered_map<std::string_view, std::string_view>;
 template <typename Ty>
 concept HasNumericLimits = std::numeric_limits<Ty>::is_specialized;
 
@@ -29,31 +64,107 @@ template <typename Ty, typename UnderlyingTy = std::underlying_type_t<Ty>>
   return static_cast<Ty>(std::numeric_limits<UnderlyingTy>::max());
 }
 
+/// Request line prefixes, indexed by method_t, ready to be copied as is.
+constexpr auto method_prefixes = std::to_array<std::string_view>(
+    {"GET ", "POST ", "PUT ", "DELETE ", "HEAD ", "OPTIONS ", "PATCH ",
+     "CONNECT ", "TRACE "});
+
+/// Packs up to 8 bytes into a little-endian word, the first byte being the
+/// lowest one. Fixed-size calls are folded into plain loads.
+template <size_t N>
+  requires(N <= 8)
+[[nodiscard]] constexpr uint64_t load_word(const char* str) noexcept {
+  uint64_t word{};
+  for (size_t i = 0; i < N; ++i) {
+    word |= uint64_t{static_cast<uint8_t>(str[i])} << (i * 8);
+  }
+  return word;
+}
+
+template <size_t N>
+[[nodiscard]] constexpr uint64_t method_word(const char (&name)[N]) noexcept {
+  return load_word<N - 1>(name);
+}
+
+/// RFC 9110 token characters
+[[nodiscard]] constexpr bool is_tchar(char c) noexcept {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') ||
+         std::string_view{"!#$%&'*+-.^_`|~"}.find(c) != std::string_view::npos;
+}
+
+/// Methods are case-sensitive, so a single word compare per candidate
+/// length is enough. Unknown tokens are reported as method_t::extension.
 inline constexpr method_t to_method(std::string_view method_str) {
-  if (method_str == "GET") {
-    return method_t::get;
-  } else if (method_str == "POST") {
-    return method_t::post;
-  } else if (method_str == "PUT") {
-    return method_t::put;
-  } else if (method_str == "DELETE") {
-    return method_t::delete_;
+  const char* str = method_str.data();
+  switch (method_str.size()) {
+    case 3:
+      if (auto word = load_word<3>(str); word == method_word("GET")) {
+        return method_t::get;
+      } else if (word == method_word("PUT")) {
+        return method_t::put;
+      }
+      break;
+    case 4:
+      if (auto word = load_word<4>(str); word == method_word("POST")) {
+        return method_t::post;
+      } else if (word == method_word("HEAD")) {
+        return method_t::head;
+      }
+      break;
+    case 5:
+      if (auto word = load_word<5>(str); word == method_word("PATCH")) {
+        return method_t::patch;
+      } else if (word == method_word("TRACE")) {
+        return method_t::trace;
+      }
+      break;
+    case 6:
+      if (load_word<6>(str) == method_word("DELETE")) {
+        return method_t::delete_;
+      }
+      break;
+    case 7:
+      if (auto word = load_word<7>(str); word == method_word("OPTIONS")) {
+        return method_t::options;
+      } else if (word == method_word("CONNECT")) {
+        return method_t::connect;
+      }
+      break;
   }
-  return detail::type_npos<method_t>();
+
+  if (method_str.empty() || !std::ranges::all_of(method_str, is_tchar)) {
+    return detail::type_npos<method_t>();
+  }
+  return method_t::extension;
+}
+
+/// Returns "METHOD " for a standard method and an empty view otherwise.
+inline constexpr std::string_view method_prefix(method_t method) {
+  auto index = static_cast<size_t>(method);
+  return index < method_prefixes.size() ? method_prefixes[index]
+                                        : std::string_view{};
 }
 
 inline constexpr std::string_view from_method(method_t method) {
+  auto prefix = method_prefix(method);
+  return prefix.substr(0, prefix.empty() ? 0 : prefix.size() - 1);
+}
+
+/// RFC 9110 9.2.2: repeating the request has the same effect as sending it
+/// once, so it may be retried after the connection was lost.
+inline constexpr bool is_idempotent(method_t method) noexcept {
   switch (method) {
     case method_t::get:
-      return "GET";
-    case method_t::post:
-      return "POST";
+    case method_t::head:
     case method_t::put:
-      return "PUT";
     case method_t::delete_:
-      return "DELETE";
+    case method_t::options:
+    case method_t::trace:
+      return true;
+    default:
+      return false;
   }
-  return {};
 }
 
 inline constexpr uint8_t to_version(std::string_view version_str) noexcept {
@@ -75,22 +186,6 @@ inline constexpr std::string_view from_version(uint8_t version) noexcept {
   return {};
 }
 
-inline headers_t to_headers(std::string_view headers_str) {
-  headers_t headers{};
-  for (size_t begin{}, end{}; end != std::string_view::npos;) {
-    end = headers_str.find(crlf_delimiter, begin);
-
-    auto header = headers_str.substr(begin, end - begin);
-    if (!header.empty()) {
-      auto [name, content] = split_view<2>(header, ": ");
-      headers[name] = content;
-    }
-
-    begin = end + crlf_delimiter.size();
-  }
-  return headers;
-}
-
 }  // namespace baklaga::http::detail
 
 #endif  // BAKLAGA_HTTP_DETAIL_MESSAGE_HPP
@@ -0,0 +1,160 @@
+#ifndef BAKLAGA_HTTP_DETAIL_RESPONSE_READER_HPP
+#define BAKLAGA_HTTP_DETAIL_RESPONSE_READER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "baklaga/http/detail/header_id.hpp"
+#include "baklaga/http/detail/message.hpp"
+#include "baklaga/http/detail/scan.hpp"
+#include "baklaga/http/message.hpp"
+#include "baklaga/http/parser.hpp"
+
+namespace baklaga::http::detail {
+/// Follows one response while it is received, independently of how bytes
+/// get into the buffer; shared by the blocking and the coroutine streams.
+class response_reader {
+ public:
+  explicit response_reader(method_t request_method) noexcept {
+    parser_.request_method(request_method);
+  }
+
+  /// Parses `data`, the response received so far, until more is needed
+  /// (need_more), the response ended (done) or it is malformed (error).
+  /// Body pieces are passed to `sink` in place.
+  template <typename SinkTy>
+  parse_event_t next(std::string_view data, SinkTy& sink) {
+    for (;;) {
+      switch (auto event = parser_.next(data)) {
+        case parse_event_t::start_line:
+          // HTTP/1.1 connections persist by default, HTTP/1.0 ones only on
+          // request
+          persistent_ = parser_.version() >= 11;
+          field_count_ = 0;
+          more_fields_.clear();
+          break;
+        case parse_event_t::header:
+          add_field(data);
+          if (parser_.header_id() == header_id_t::connection) {
+            auto content = parser_.header().second;
+            if (has_token(content, "close")) {
+              persistent_ = false;
+            } else if (has_token(content, "keep-alive")) {
+              persistent_ = true;
+            }
+          }
+          break;
+        case parse_event_t::body:
+          sink(parser_.body());
+          break;
+        case parse_event_t::headers_done:
+        case parse_event_t::trailer:
+          break;
+        default:
+          return event;
+      }
+    }
+  }
+
+  /// Tells the reader the peer closed the connection. Returns true if that
+  /// completes the response.
+  bool finish() noexcept {
+    if (!parser_.finish()) {
+      return false;
+    }
+    persistent_ = false;
+    return true;
+  }
+
+  /// Removes the body bytes passed to the sink from `data`, which holds
+  /// `received` bytes, and returns how many remain. Keeps the buffer of a
+  /// streamed body bounded.
+  size_t discard_body(char* data, size_t received) noexcept {
+    auto begin = parser_.header_size();
+    auto end = parser_.body_offset();
+    if (end <= begin) {
+      return received;
+    }
+    std::memmove(data + begin, data + end, received - end);
+    parser_.discard_body();
+    return received - (end - begin);
+  }
+
+  /// Accounts for `size` body bytes a sink took straight from the socket.
+  void skip_body(uint64_t size) noexcept { parser_.skip_body(size); }
+
+  /// Moves a body piece right behind the previous one, so a chunked body
+  /// ends up contiguous after the header block. Content-Length and
+  /// close-delimited bodies are already in place and are not copied.
+  void gather_body(char* data, std::string_view piece) noexcept {
+    auto* out = data + parser_.header_size() + body_size_;
+    if (out != piece.data()) {
+      std::memmove(out, piece.data(), piece.size());
+    }
+    body_size_ += piece.size();
+  }
+
+  /// The response in `data`, with the body collected by gather_body(). Made
+  /// of what the parser reported, the header block is not parsed again.
+  response_view response(std::string_view data) const {
+    headers_t headers;
+    auto add = [&](const field_t& field) {
+      headers.emplace(field.id, data.substr(field.name, field.name_size),
+                      data.substr(field.content, field.content_size));
+    };
+    std::for_each(fields_.begin(),
+                  fields_.begin() + std::min(field_count_, fields_.size()),
+                  add);
+    std::ranges::for_each(more_fields_, add);
+
+    response_view result{parser_.version(), parser_.status_code(),
+                         std::move(headers)};
+    result.body(data.substr(parser_.header_size(), body_size_));
+    return result;
+  }
+
+  /// True if the connection may carry another request after this response
+  bool persistent() const noexcept {
+    return persistent_ && parser_.framing() != body_framing_t::close;
+  }
+  const auto& parser() const noexcept { return parser_; }
+
+ private:
+  /// A header field as offsets into the buffer, which may be reallocated
+  /// while the rest of the header block is received
+  struct field_t {
+    header_id_t id;
+    size_t name;
+    size_t name_size;
+    size_t content;
+    size_t content_size;
+  };
+
+  void add_field(std::string_view data) {
+    auto [name, content] = parser_.header();
+    field_t field{parser_.header_id(),
+                  static_cast<size_t>(name.data() - data.data()), name.size(),
+                  static_cast<size_t>(content.data() - data.data()),
+                  content.size()};
+    if (field_count_ < fields_.size()) {
+      fields_[field_count_++] = field;
+    } else {
+      more_fields_.push_back(field);
+    }
+  }
+
+  response_parser parser_;
+  size_t body_size_{};
+  bool persistent_{};
+  // Fields of a typical response stay inline, like in headers_t
+  std::array<field_t, 24> fields_;
+  size_t field_count_{};
+  std::vector<field_t> more_fields_;
+};
+}  // namespace baklaga::http::detail
+
+#endif  // BAKLAGA_HTTP_DETAIL_RESPONSE_READER_HPP
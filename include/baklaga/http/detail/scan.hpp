@@ -0,0 +1,279 @@
+#ifndef BAKLAGA_HTTP_DETAIL_SCAN_HPP
+#define BAKLAGA_HTTP_DETAIL_SCAN_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "baklaga/http/detail/string.hpp"
+
+#if !defined(BAKLAGA_HTTP_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define BAKLAGA_HTTP_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(BAKLAGA_HTTP_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BAKLAGA_HTTP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BAKLAGA_HTTP_TARGET_AVX2
+#endif
+
+namespace baklaga::http::detail {
+/// Returns a pointer to the first '\n' (and ':' if WithColon is set) in
+/// [first, last), or last if there is none.
+using scan_fn_t = const char* (*)(const char* first, const char* last) noexcept;
+
+template <bool WithColon>
+const char* scan_scalar(const char* first, const char* last) noexcept {
+  for (; first != last; ++first) {
+    if (*first == '\n' || (WithColon && *first == ':')) {
+      return first;
+    }
+  }
+  return last;
+}
+
+#ifdef BAKLAGA_HTTP_SIMD_X86
+template <bool WithColon>
+const char* scan_sse2(const char* first, const char* last) noexcept {
+  const auto lf = _mm_set1_epi8('\n');
+  const auto colon = _mm_set1_epi8(':');
+  for (; last - first >= 16; first += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    auto matches = _mm_cmpeq_epi8(block, lf);
+    if constexpr (WithColon) {
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, colon));
+    }
+    if (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matches))) {
+      return first + std::countr_zero(mask);
+    }
+  }
+  return scan_scalar<WithColon>(first, last);
+}
+
+template <bool WithColon>
+BAKLAGA_HTTP_TARGET_AVX2 const char* scan_avx2(const char* first,
+                                               const char* last) noexcept {
+  const auto lf = _mm256_set1_epi8('\n');
+  const auto colon = _mm256_set1_epi8(':');
+  for (; last - first >= 32; first += 32) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    auto matches = _mm256_cmpeq_epi8(block, lf);
+    if constexpr (WithColon) {
+      matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, colon));
+    }
+    if (auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches))) {
+      return first + std::countr_zero(mask);
+    }
+  }
+  return scan_sse2<WithColon>(first, last);
+}
+
+inline bool has_avx2() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4]{};
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  // OSXSAVE and AVX, then make sure the OS saves the YMM state
+  constexpr int osxsave_avx = (1 << 27) | (1 << 28);
+  if ((info[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+/// Sets bit i of out[k] if byte i of the 64 bytes at `data` is the k-th of
+/// the classified characters: one pass yields the positions of every
+/// delimiter of a block at once.
+using classify_fn_t = void (*)(const char* data, uint64_t* out) noexcept;
+
+template <char... Cs>
+void classify_scalar(const char* data, uint64_t* out) noexcept {
+  constexpr char set[] = {Cs...};
+  for (size_t k = 0; k < sizeof...(Cs); ++k) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+      mask |= static_cast<uint64_t>(data[i] == set[k]) << i;
+    }
+    out[k] = mask;
+  }
+}
+
+#ifdef BAKLAGA_HTTP_SIMD_X86
+template <char... Cs>
+void classify_sse2(const char* data, uint64_t* out) noexcept {
+  constexpr char set[] = {Cs...};
+  __m128i blocks[4];
+  for (size_t i = 0; i < 4; ++i) {
+    blocks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i);
+  }
+  for (size_t k = 0; k < sizeof...(Cs); ++k) {
+    const auto needle = _mm_set1_epi8(set[k]);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 4; ++i) {
+      mask |= static_cast<uint64_t>(static_cast<uint32_t>(
+                  _mm_movemask_epi8(_mm_cmpeq_epi8(blocks[i], needle))))
+              << (16 * i);
+    }
+    out[k] = mask;
+  }
+}
+
+template <char... Cs>
+BAKLAGA_HTTP_TARGET_AVX2 void classify_avx2(const char* data,
+                                            uint64_t* out) noexcept {
+  constexpr char set[] = {Cs...};
+  const auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+  const auto high =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+  for (size_t k = 0; k < sizeof...(Cs); ++k) {
+    const auto needle = _mm256_set1_epi8(set[k]);
+    out[k] = static_cast<uint64_t>(static_cast<uint32_t>(
+                 _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle)))) |
+             static_cast<uint64_t>(static_cast<uint32_t>(
+                 _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle))))
+                 << 32;
+  }
+}
+#endif
+
+/// Widest classify kernel for `Cs` supported by the running CPU.
+template <char... Cs>
+classify_fn_t classifier() noexcept {
+  static const classify_fn_t instance = [] {
+#ifdef BAKLAGA_HTTP_SIMD_X86
+    return has_avx2() ? classify_fn_t{classify_avx2<Cs...>}
+                      : classify_fn_t{classify_sse2<Cs...>};
+#else
+    return classify_fn_t{classify_scalar<Cs...>};
+#endif
+  }();
+  return instance;
+}
+
+struct scanner_t {
+  scan_fn_t find_lf;
+  scan_fn_t find_lf_or_colon;
+};
+
+/// Picks the widest scanning kernel supported by the running CPU.
+inline const scanner_t& scanner() noexcept {
+  static const scanner_t instance = [] {
+#ifdef BAKLAGA_HTTP_SIMD_X86
+    if (has_avx2()) {
+      return scanner_t{scan_avx2<false>, scan_avx2<true>};
+    }
+    return scanner_t{scan_sse2<false>, scan_sse2<true>};
+#else
+    return scanner_t{scan_scalar<false>, scan_scalar<true>};
+#endif
+  }();
+  return instance;
+}
+
+/// Position of a single line inside the scanned buffer. `end` excludes the
+/// line terminator, `colon` is the first ':' of the line or npos.
+struct line_t {
+  size_t begin;
+  size_t end;
+  size_t colon;
+
+  [[nodiscard]] constexpr bool empty() const noexcept { return begin == end; }
+};
+
+/// Splits a growing buffer into lines. Scanning resumes where the previous
+/// call stopped, so every byte is visited once no matter how the buffer was
+/// filled. Only offsets are kept: the buffer may be reallocated between calls
+/// as long as already received bytes keep their positions.
+class line_reader {
+ public:
+  line_reader() = default;
+  explicit line_reader(size_t position) noexcept { reset(position); }
+
+  /// Returns false if the current line is not terminated yet.
+  bool next(std::string_view buffer, line_t& line,
+            bool find_colon = true) noexcept {
+    const auto& scan = scanner();
+    const char* base = buffer.data();
+    const char* last = base + buffer.size();
+
+    const char* it = base + scanned_;
+    if (find_colon && colon_ == std::string_view::npos) {
+      it = scan.find_lf_or_colon(it, last);
+      if (it != last && *it == ':') {
+        colon_ = static_cast<size_t>(it - base);
+        it = scan.find_lf(it + 1, last);
+      }
+    } else {
+      it = scan.find_lf(it, last);
+    }
+
+    if (it == last) {
+      scanned_ = buffer.size();
+      return false;
+    }
+
+    auto lf = static_cast<size_t>(it - base);
+    line.begin = begin_;
+    line.end = (lf > begin_ && buffer[lf - 1] == '\r') ? lf - 1 : lf;
+    line.colon = colon_;
+    reset(lf + 1);
+    return true;
+  }
+
+  /// Offset of the first byte that is not part of a complete line.
+  [[nodiscard]] size_t position() const noexcept { return begin_; }
+
+  void reset(size_t position = 0) noexcept {
+    begin_ = position;
+    scanned_ = position;
+    colon_ = std::string_view::npos;
+  }
+
+ private:
+  size_t begin_{};
+  size_t scanned_{};
+  size_t colon_ = std::string_view::npos;
+};
+
+/// Strips optional whitespace (SP / HTAB) around a header value.
+[[nodiscard]] constexpr std::string_view trim_ows(
+    std::string_view str) noexcept {
+  auto is_ows = [](char c) { return c == ' ' || c == '\t'; };
+  while (!str.empty() && is_ows(str.front())) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && is_ows(str.back())) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+/// Looks for `token` in a comma-separated list such as a Connection header.
+[[nodiscard]] constexpr bool has_token(std::string_view list,
+                                       std::string_view token) noexcept {
+  for (;;) {
+    auto comma = list.find(',');
+    if (iequals(trim_ows(list.substr(0, comma)), token)) {
+      return true;
+    } else if (comma == std::string_view::npos) {
+      return false;
+    }
+    list.remove_prefix(comma + 1);
+  }
+}
+}  // namespace baklaga::http::detail
+
+#endif  // BAKLAGA_HTTP_DETAIL_SCAN_HPP
@@ -2,6 +2,7 @@
 #define BAKLAGA_HTTP_DETAIL_STATUS_CODE_HPP
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string_view>
 
@@ -149,18 +150,117 @@ constexpr auto status_code_map = std::to_array<mapped_status_code>(
      {status_code_t::network_authentication_required,
       "Network Authentication Required"}});
 
+constexpr uint16_t status_code_min = 100;
+constexpr uint16_t status_code_max = 599;
+
 constexpr bool is_valid_status_code(status_code_t code) {
-  return code < status_code_t(100) || code > status_code_t(599);
+  return code >= status_code_t(status_code_min) &&
+         code <= status_code_t(status_code_max);
 }
 
+/// Reason phrases indexed by `code - status_code_min`, empty for unknown
+/// codes.
+constexpr auto status_reasons = [] {
+  std::array<std::string_view, status_code_max - status_code_min + 1> result{};
+  for (const auto& [code, reason] : status_code_map) {
+    result[static_cast<uint16_t>(code) - status_code_min] = reason;
+  }
+  return result;
+}();
+
 constexpr std::string_view from_status_code(status_code_t status_code) {
   if (!is_valid_status_code(status_code)) {
     return std::string_view{};
   }
-  auto it = std::ranges::find(status_code_map, status_code,
-                              &mapped_status_code::first);
-  return (it != status_code_map.end()) ? it->second : std::string_view{};
+  return status_reasons[static_cast<uint16_t>(status_code) - status_code_min];
+}
+
+/// Three decimal digits of every code from 000 to 999, used to serialize
+/// codes without a prebuilt status line.
+constexpr auto status_code_digit_table = [] {
+  std::array<char, 1000 * 3> result{};
+  for (size_t code = 0; code < 1000; ++code) {
+    result[code * 3] = static_cast<char>('0' + code / 100);
+    result[code * 3 + 1] = static_cast<char>('0' + code / 10 % 10);
+    result[code * 3 + 2] = static_cast<char>('0' + code % 10);
+  }
+  return result;
+}();
+
+/// Status codes are three digits (RFC 9110 section 15), larger values are
+/// truncated.
+constexpr std::string_view status_code_digits(status_code_t status_code) {
+  auto code = static_cast<size_t>(status_code) % 1000;
+  return {status_code_digit_table.data() + code * 3, 3};
 }
+
+/// Versions with prebuilt status lines, in the order they are stored.
+constexpr auto status_line_versions =
+    std::to_array<std::string_view>({"HTTP/1.0", "HTTP/1.1"});
+
+/// "HTTP/1.1 200 OK\r\n" without the reason phrase
+constexpr size_t status_line_overhead = 8 + 1 + 3 + 1 + 2;
+
+constexpr size_t status_lines_size = [] {
+  size_t size{};
+  for (const auto& [_, reason] : status_code_map) {
+    size += status_line_overhead + reason.size();
+  }
+  return size * status_line_versions.size();
+}();
+
+/// Every known status line for every supported version, concatenated, plus
+/// offsets indexed by `version index * codes + code - status_code_min`.
+struct status_lines_t {
+  std::array<char, status_lines_size> data;
+  std::array<uint16_t, status_line_versions.size() * status_reasons.size()>
+      offsets;
+};
+
+constexpr status_lines_t status_lines = [] {
+  status_lines_t result{};
+  size_t position{};
+  auto append = [&](std::string_view str) {
+    for (char c : str) {
+      result.data[position++] = c;
+    }
+  };
+
+  for (size_t version = 0; version < status_line_versions.size(); ++version) {
+    for (const auto& [code, reason] : status_code_map) {
+      auto value = static_cast<uint16_t>(code);
+      result.offsets[version * status_reasons.size() + value -
+                     status_code_min] = static_cast<uint16_t>(position);
+
+      append(status_line_versions[version]);
+      append(" ");
+      append(status_code_digits(code));
+      append(" ");
+      append(reason);
+      append("\r\n");
+    }
+  }
+  return result;
+}();
+
+/// Returns the complete status line, e.g. "HTTP/1.1 200 OK\r\n", or an empty
+/// view if the version or the status code is not known.
+constexpr std::string_view status_line(uint8_t version,
+                                       status_code_t status_code) {
+  auto reason = from_status_code(status_code);
+  if (reason.empty() || version < 10 || version > 11) {
+    return std::string_view{};
+  }
+
+  size_t index = static_cast<size_t>(version - 10) * status_reasons.size() +
+                 static_cast<uint16_t>(status_code) - status_code_min;
+  return {status_lines.data.data() + status_lines.offsets[index],
+          status_line_overhead + reason.size()};
+}
+
+static_assert(status_line(11, status_code_t::ok) == "HTTP/1.1 200 OK\r\n");
+static_assert(status_line(10, status_code_t::not_found) ==
+              "HTTP/1.0 404 Not Found\r\n");
 }  // namespace baklaga::http::detail
 
 #endif  // BAKLAGA_HTTP_DETAIL_STATUS_CODE_HPP
@@ -3,6 +3,8 @@
 
 #include <array>
 #include <charconv>
+#include <concepts>
+#include <limits>
 #include <ranges>
 #include <string_view>
 #include <system_error>
@@ -27,6 +29,24 @@ template <std::size_t N>
   return result;
 }
 
+[[nodiscard]] constexpr char to_lower(char c) noexcept {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+/// ASCII case-insensitive comparison, as used for header names.
+[[nodiscard]] constexpr bool iequals(std::string_view lhs,
+                                     std::string_view rhs) noexcept {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    if (to_lower(lhs[i]) != to_lower(rhs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <typename T, typename DecayedT = std::decay_t<T>>
   requires(std::is_arithmetic_v<DecayedT> || std::is_enum_v<DecayedT>)
 struct convert_result_t {
@@ -59,6 +79,28 @@ template <typename T, typename DecayedT = std::decay_t<T>,
   }
 }
 
+/// Strict decimal number for protocol fields such as Content-Length: every
+/// byte has to be a DIGIT and the value has to fit `T`. Unlike
+/// to_arithmetic(), an empty string, a sign or trailing bytes are errors.
+template <std::unsigned_integral T>
+[[nodiscard]] inline convert_result_t<T> to_decimal(
+    std::string_view str) noexcept {
+  if (str.empty()) {
+    return {0, std::make_error_code(std::errc::invalid_argument)};
+  }
+  T value{};
+  for (char c : str) {
+    if (c < '0' || c > '9') {
+      return {0, std::make_error_code(std::errc::invalid_argument)};
+    }
+    auto digit = static_cast<T>(c - '0');
+    if (value > (std::numeric_limits<T>::max() - digit) / 10) {
+      return {0, std::make_error_code(std::errc::result_out_of_range)};
+    }
+    value = static_cast<T>(value * 10 + digit);
+  }
+  return {value, {}};
+}
 }  // namespace baklaga::http::detail
 
 #endif  // BAKLAGA_HTTP_DETAIL_STRING_HPP
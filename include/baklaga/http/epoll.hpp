@@ -0,0 +1,410 @@
+#ifndef BAKLAGA_HTTP_EPOLL_HPP
+#define BAKLAGA_HTTP_EPOLL_HPP
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "baklaga/http/resolver.hpp"
+#include "baklaga/http/task.hpp"
+#include "baklaga/http/timer_wheel.hpp"
+
+namespace baklaga::http {
+/// A pending socket operation. The reactor calls `perform` whenever the
+/// descriptor becomes ready and resumes `handle` once it returns true, so a
+/// spurious wakeup never reaches the coroutine.
+struct epoll_operation {
+  bool (*perform)(epoll_operation&){};
+  std::coroutine_handle<> handle;
+  std::error_code* error{};
+};
+
+/// Single-threaded reactor driving coroutines over edge-triggered epoll.
+/// Reference executor for async_stream; descriptors are registered once and
+/// their waiting operations are kept in a table indexed by descriptor, so
+/// waiting for I/O does not allocate. Deadlines of its sockets run on the
+/// timer wheel of the reactor, see timers().
+class epoll_executor {
+ public:
+  epoll_executor() : fd_{::epoll_create1(EPOLL_CLOEXEC)} {}
+  ~epoll_executor() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  epoll_executor(const epoll_executor&) = delete;
+  epoll_executor& operator=(const epoll_executor&) = delete;
+
+  /// Starts `t` on the next iteration of run(). The task owns itself from
+  /// then on and is destroyed when it completes.
+  template <typename Ty>
+  void spawn(task<Ty> t) {
+    post(t.detach());
+  }
+
+  /// Resumes `handle` on the next iteration of run().
+  void post(std::coroutine_handle<> handle) { ready_.push_back(handle); }
+
+  /// Runs until no coroutine is ready or waiting for I/O.
+  void run() {
+    while (run_once(-1)) {
+    }
+  }
+
+  /// Resumes the ready coroutines, then waits up to `timeout_ms` for I/O
+  /// (-1 waits indefinitely, or until the next timer is due) and completes
+  /// the operations that became ready, then fires the expired timers.
+  /// Returns false once there is nothing left to do.
+  bool run_once(int timeout_ms) {
+    while (!ready_.empty()) {
+      running_.swap(ready_);
+      for (auto handle : running_) {
+        handle.resume();
+      }
+      running_.clear();
+    }
+    if (waiting_ == 0) {
+      return false;
+    }
+
+    auto timer_ms = timers_.timeout_ms();
+    if (timer_ms >= 0 && (timeout_ms < 0 || timer_ms < timeout_ms)) {
+      timeout_ms = timer_ms;
+    }
+    std::array<epoll_event, 64> events;
+    auto count = ::epoll_wait(fd_, events.data(),
+                              static_cast<int>(events.size()), timeout_ms);
+    for (int i = 0; i < count; ++i) {
+      auto fd = events[i].data.fd;
+      auto flags = events[i].events;
+      constexpr uint32_t failed = EPOLLERR | EPOLLHUP;
+      if (flags & (EPOLLIN | EPOLLRDHUP | failed)) {
+        complete(slot(fd).reader);
+      }
+      if (flags & (EPOLLOUT | failed)) {
+        complete(slot(fd).writer);
+      }
+    }
+    timers_.advance();
+    return true;
+  }
+
+  /// Registers `fd` for edge-triggered readiness notifications.
+  void add(int fd, std::error_code& ec) {
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.fd = fd;
+    if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ec = std::error_code{errno, std::system_category()};
+      return;
+    }
+    slot(fd) = {};
+  }
+
+  /// Unregisters `fd`. Operations still waiting on it complete with
+  /// operation_canceled.
+  void remove(int fd) noexcept {
+    ::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+    cancel(fd, std::make_error_code(std::errc::operation_canceled));
+  }
+
+  /// Completes the operations waiting on `fd` with `reason`, the descriptor
+  /// stays registered.
+  void cancel(int fd, std::error_code reason) noexcept {
+    if (fd < 0 || static_cast<size_t>(fd) >= slots_.size()) {
+      return;
+    }
+    for (auto* op : {std::exchange(slots_[fd].reader, nullptr),
+                     std::exchange(slots_[fd].writer, nullptr)}) {
+      if (op != nullptr) {
+        --waiting_;
+        *op->error = reason;
+        post(op->handle);
+      }
+    }
+  }
+
+  /// Parks `op` until `fd` is readable (or writable).
+  void wait(int fd, bool write, epoll_operation& op) noexcept {
+    auto& entry = slot(fd);
+    (write ? entry.writer : entry.reader) = &op;
+    ++waiting_;
+  }
+
+  /// Timers advanced by run_once(), shared by every socket of the reactor
+  timer_wheel& timers() noexcept { return timers_; }
+
+ private:
+  struct slot_t {
+    epoll_operation* reader{};
+    epoll_operation* writer{};
+  };
+
+  slot_t& slot(int fd) {
+    if (static_cast<size_t>(fd) >= slots_.size()) {
+      slots_.resize(static_cast<size_t>(fd) + 1);
+    }
+    return slots_[fd];
+  }
+
+  void complete(epoll_operation*& waiting) {
+    auto* op = std::exchange(waiting, nullptr);
+    if (op == nullptr) {
+      return;
+    }
+    if (!op->perform(*op)) {
+      waiting = op;
+      return;
+    }
+    --waiting_;
+    op->handle.resume();
+  }
+
+  int fd_;
+  size_t waiting_{};
+  std::vector<slot_t> slots_;
+  std::vector<std::coroutine_handle<>> ready_;
+  std::vector<std::coroutine_handle<>> running_;
+  timer_wheel timers_;
+};
+
+/// Non-blocking TCP socket for epoll_executor, satisfies
+/// concept_::cancellable_socket and concept_::async_address_socket. Host
+/// names passed to async_connect() are resolved with getaddrinfo, which
+/// blocks; async_stream::resolver() avoids that.
+class epoll_socket {
+ public:
+  explicit epoll_socket(epoll_executor& executor) noexcept
+      : executor_{&executor} {}
+  epoll_socket(epoll_socket&& other) noexcept
+      : executor_{other.executor_},
+        fd_{std::exchange(other.fd_, -1)},
+        aborted_{std::exchange(other.aborted_, {})} {}
+  epoll_socket& operator=(epoll_socket&& other) noexcept {
+    if (this != &other) {
+      std::error_code ec;
+      close(ec);
+      executor_ = other.executor_;
+      fd_ = std::exchange(other.fd_, -1);
+      aborted_ = std::exchange(other.aborted_, {});
+    }
+    return *this;
+  }
+  ~epoll_socket() {
+    std::error_code ec;
+    close(ec);
+  }
+
+  /// The descriptor is created by async_connect() once the address family
+  /// is known.
+  void open(std::error_code&) noexcept { aborted_.clear(); }
+
+  task<void> async_connect(std::string_view host, std::string_view port,
+                           std::error_code& ec) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses{};
+    if (auto result = ::getaddrinfo(std::string{host}.c_str(),
+                                    std::string{port}.c_str(), &hints,
+                                    &addresses);
+        result != 0) {
+      ec = std::make_error_code(std::errc::host_unreachable);
+      co_return;
+    }
+
+    for (auto* address = addresses; address != nullptr;
+         address = address->ai_next) {
+      close(ec);
+      ec.clear();
+      co_await connect_awaiter{*this, address->ai_addr, address->ai_addrlen,
+                               ec};
+      if (!ec || aborted_) {
+        break;
+      }
+    }
+    ::freeaddrinfo(addresses);
+  }
+
+  /// Connects to a resolved address.
+  auto async_connect(const http::address& address, std::error_code& ec) {
+    close(ec);
+    ec.clear();
+    return connect_awaiter{*this, address.data(), address.size(), ec};
+  }
+
+  auto async_read(std::span<uint8_t> buffer, std::error_code& ec) noexcept {
+    return io_awaiter<false>{*this, buffer, ec};
+  }
+  auto async_write(std::span<const uint8_t> buffer,
+                   std::error_code& ec) noexcept {
+    return io_awaiter<true>{*this, buffer, ec};
+  }
+
+  void shutdown(std::error_code& ec) noexcept {
+    if (fd_ >= 0 && ::shutdown(fd_, SHUT_RDWR) != 0) {
+      ec = std::error_code{errno, std::system_category()};
+    }
+  }
+  void close(std::error_code& ec) noexcept {
+    if (fd_ < 0) {
+      return;
+    }
+    executor_->remove(fd_);
+    if (::close(std::exchange(fd_, -1)) != 0) {
+      ec = std::error_code{errno, std::system_category()};
+    }
+  }
+
+  /// Completes the pending operations with `reason`, later ones fail with
+  /// it until the next open().
+  void cancel(std::error_code reason) noexcept {
+    aborted_ = reason;
+    executor_->cancel(fd_, reason);
+  }
+  timer_wheel& timers() noexcept { return executor_->timers(); }
+
+  int native_handle() const noexcept { return fd_; }
+
+ private:
+  static bool would_block() noexcept {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+
+  /// Tries the operation right away and waits for readiness only if the
+  /// socket would block.
+  template <bool Write>
+  struct io_awaiter : epoll_operation {
+    using span_t =
+        std::conditional_t<Write, std::span<const uint8_t>, std::span<uint8_t>>;
+
+    io_awaiter(epoll_socket& socket, span_t buffer, std::error_code& ec)
+        : socket_{socket}, buffer_{buffer} {
+      perform = &io_awaiter::try_io;
+      error = &ec;
+    }
+
+    bool await_ready() noexcept { return try_io(*this); }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle = awaiting;
+      socket_.executor_->wait(socket_.fd_, Write, *this);
+    }
+    size_t await_resume() const noexcept { return transferred_; }
+
+    static bool try_io(epoll_operation& base) noexcept {
+      auto& self = static_cast<io_awaiter&>(base);
+      if (self.socket_.aborted_) {
+        *self.error = self.socket_.aborted_;
+        return true;
+      } else if (self.socket_.fd_ < 0) {
+        *self.error = std::make_error_code(std::errc::bad_file_descriptor);
+        return true;
+      }
+      for (;;) {
+        ssize_t result{};
+        if constexpr (Write) {
+          result = ::send(self.socket_.fd_, self.buffer_.data(),
+                          self.buffer_.size(), MSG_NOSIGNAL);
+        } else {
+          result = ::recv(self.socket_.fd_, self.buffer_.data(),
+                          self.buffer_.size(), 0);
+        }
+        if (result >= 0) {
+          self.transferred_ = static_cast<size_t>(result);
+          return true;
+        } else if (errno == EINTR) {
+          continue;
+        } else if (would_block()) {
+          return false;
+        }
+        *self.error = std::error_code{errno, std::system_category()};
+        return true;
+      }
+    }
+
+    epoll_socket& socket_;
+    span_t buffer_;
+    size_t transferred_{};
+  };
+
+  /// Starts a non-blocking connect and waits until the socket is writable.
+  struct connect_awaiter : epoll_operation {
+    connect_awaiter(epoll_socket& socket, const sockaddr* address,
+                    socklen_t size, std::error_code& ec)
+        : socket_{socket}, address_{address}, size_{size} {
+      perform = &connect_awaiter::finish;
+      error = &ec;
+    }
+
+    bool await_ready() noexcept {
+      if (socket_.aborted_) {
+        *error = socket_.aborted_;
+        return true;
+      }
+      auto fd = ::socket(address_->sa_family,
+                         SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        *error = std::error_code{errno, std::system_category()};
+        return true;
+      }
+      socket_.fd_ = fd;
+      socket_.executor_->add(fd, *error);
+      if (*error) {
+        return true;
+      }
+      if (::connect(fd, address_, size_) == 0) {
+        return true;
+      } else if (errno != EINPROGRESS) {
+        *error = std::error_code{errno, std::system_category()};
+        return true;
+      }
+      return false;
+    }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle = awaiting;
+      socket_.executor_->wait(socket_.fd_, true, *this);
+    }
+    void await_resume() const noexcept {}
+
+    static bool finish(epoll_operation& base) noexcept {
+      auto& self = static_cast<connect_awaiter&>(base);
+      int result{};
+      socklen_t size = sizeof(result);
+      if (::getsockopt(self.socket_.fd_, SOL_SOCKET, SO_ERROR, &result,
+                       &size) != 0) {
+        result = errno;
+      }
+      if (result != 0) {
+        *self.error = std::error_code{result, std::system_category()};
+      }
+      return true;
+    }
+
+    epoll_socket& socket_;
+    const sockaddr* address_;
+    socklen_t size_;
+  };
+
+  epoll_executor* executor_;
+  int fd_{-1};
+  std::error_code aborted_;
+};
+}  // namespace baklaga::http
+#endif  // defined(__linux__)
+
+#endif  // BAKLAGA_HTTP_EPOLL_HPP
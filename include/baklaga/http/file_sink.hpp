@@ -0,0 +1,230 @@
+#ifndef BAKLAGA_HTTP_FILE_SINK_HPP
+#define BAKLAGA_HTTP_FILE_SINK_HPP
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace baklaga::http {
+/// Body sink writing into a file descriptor at its current position, for
+/// stream::read(buffer, sink, ec). Over a socket that opts into direct I/O
+/// (see concept_::direct_io_socket) the stream lets the sink take body
+/// bytes straight from the socket: the parser still reads the framing
+/// (chunk headers), but payload bytes never reach user space. Only the
+/// bytes that arrived together with the header block or a chunk header are
+/// written with write(). Any other socket passes the whole body through
+/// operator().
+///
+/// - splice: socket to a pipe to the file, pages move in the kernel; works
+///   for any file type that supports splice (not O_APPEND files).
+/// - mmap: the file is extended to the announced size and the socket is
+///   received into a shared mapping of it; needs a regular file. Bodies of
+///   unknown size (close-delimited) still go through splice.
+///
+/// Each transfer() blocks at most once and moves at most 1 MiB, so the
+/// stream checks its deadlines in between. If the stream gives up on a
+/// body in mmap mode, the file keeps its reserved size until the sink is
+/// destroyed.
+class file_sink {
+ public:
+  enum class mode_t : uint8_t { splice, mmap };
+
+  explicit file_sink(int fd, mode_t mode = mode_t::splice) noexcept
+      : fd_{fd}, mode_{mode} {}
+  file_sink(file_sink&& other) noexcept
+      : fd_{other.fd_},
+        mode_{other.mode_},
+        pipe_{std::exchange(other.pipe_, {-1, -1})},
+        extended_{std::exchange(other.extended_, false)},
+        original_size_{other.original_size_},
+        written_{other.written_},
+        error_{other.error_} {}
+  file_sink& operator=(file_sink&&) = delete;
+  ~file_sink() {
+    if (extended_) {
+      // The stream gave up on the body (e.g. a deadline), drop the space
+      // reserved for the rest of it
+      auto position = ::lseek(fd_, 0, SEEK_CUR);
+      if (position >= 0) {
+        ::ftruncate(fd_, std::max(original_size_, position));
+      }
+    }
+    for (auto fd : pipe_) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  /// Writes a piece of the body that passed through the receive buffer.
+  void operator()(std::string_view piece) {
+    while (!piece.empty() && !error_) {
+      auto result = ::write(fd_, piece.data(), piece.size());
+      if (result < 0 && errno != EINTR) {
+        error_ = {errno, std::system_category()};
+      } else if (result > 0) {
+        piece.remove_prefix(static_cast<size_t>(result));
+        written_ += static_cast<uint64_t>(result);
+      }
+    }
+  }
+
+  /// Moves up to `size` body bytes from `socket` into the file. Returns the
+  /// number of bytes moved, zero once the peer closed the connection.
+  uint64_t transfer(int socket, uint64_t size, std::error_code& ec) {
+    if (error_) {
+      ec = error_;
+      return 0;
+    }
+    auto moved = mode_ == mode_t::mmap &&
+                         size != std::numeric_limits<uint64_t>::max()
+                     ? receive_mapped(socket, size, ec)
+                     : splice(socket, size, ec);
+    written_ += moved;
+    if (ec) {
+      error_ = ec;
+    }
+    return moved;
+  }
+
+  /// Body bytes written to the file so far
+  uint64_t written() const noexcept { return written_; }
+  /// First error writing the file, stream::read() reports it as well
+  const std::error_code& error() const noexcept { return error_; }
+
+ private:
+  static constexpr size_t pipe_size = 1 << 20;
+
+  static std::error_code last_error() noexcept {
+    return {errno, std::system_category()};
+  }
+
+  uint64_t splice(int socket, uint64_t size, std::error_code& ec) {
+    if (pipe_[0] < 0) {
+      if (::pipe2(pipe_.data(), O_CLOEXEC) != 0) {
+        ec = last_error();
+        return 0;
+      }
+      // Larger pipes move more per call, the default (64 KiB) still works
+      ::fcntl(pipe_[1], F_SETPIPE_SZ, static_cast<int>(pipe_size));
+    }
+
+    auto window = static_cast<size_t>(std::min<uint64_t>(size, pipe_size));
+    ssize_t filled{};
+    do {
+      filled = ::splice(socket, nullptr, pipe_[1], nullptr, window,
+                        SPLICE_F_MOVE | SPLICE_F_MORE);
+    } while (filled < 0 && errno == EINTR);
+    if (filled <= 0) {
+      if (filled < 0) {
+        ec = last_error();
+      }
+      return 0;
+    }
+
+    for (auto left = static_cast<size_t>(filled); left != 0;) {
+      auto drained =
+          ::splice(pipe_[0], nullptr, fd_, nullptr, left, SPLICE_F_MOVE);
+      if (drained < 0 && errno != EINTR) {
+        ec = last_error();
+        return static_cast<uint64_t>(filled) - left;
+      } else if (drained > 0) {
+        left -= static_cast<size_t>(drained);
+      }
+    }
+    return static_cast<uint64_t>(filled);
+  }
+
+  uint64_t receive_mapped(int socket, uint64_t size, std::error_code& ec) {
+    auto position = ::lseek(fd_, 0, SEEK_CUR);
+    struct stat info {};
+    if (position < 0 || ::fstat(fd_, &info) != 0) {
+      ec = last_error();
+      return 0;
+    }
+    // The whole rest of the body is reserved up front, the first call
+    // remembers the size to cut the file back to if the body ends early
+    auto end = position + static_cast<off_t>(size);
+    if (info.st_size < end) {
+      if (!extended_) {
+        extended_ = true;
+        original_size_ = info.st_size;
+      }
+      if (::ftruncate(fd_, end) != 0) {
+        ec = last_error();
+        return 0;
+      }
+    }
+
+    // Mappings start at a page boundary
+    auto window = static_cast<size_t>(std::min<uint64_t>(size, pipe_size));
+    auto page = static_cast<off_t>(::sysconf(_SC_PAGESIZE));
+    auto offset = position - position % page;
+    auto length = static_cast<size_t>(position - offset) + window;
+    auto* map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd_, offset);
+    if (map == MAP_FAILED) {
+      ec = last_error();
+      return 0;
+    }
+
+    // Only the first recv may block, the rest take what already arrived
+    auto* out = static_cast<char*>(map) + (position - offset);
+    size_t moved{};
+    bool ended{};
+    while (moved < window) {
+      auto result = ::recv(socket, out + moved, window - moved,
+                           moved == 0 ? 0 : MSG_DONTWAIT);
+      if (result > 0) {
+        moved += static_cast<size_t>(result);
+      } else if (result == 0) {
+        ended = true;
+        break;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (moved == 0) {
+          ec = last_error();
+        }
+        break;
+      } else if (errno != EINTR) {
+        ec = last_error();
+        break;
+      }
+    }
+    ::munmap(map, length);
+
+    auto stop = position + static_cast<off_t>(moved);
+    if (extended_ && (ended || ec)) {
+      ::ftruncate(fd_, std::max(original_size_, stop));
+    }
+    if (ended || ec || moved == size) {
+      extended_ = false;
+    }
+    ::lseek(fd_, stop, SEEK_SET);
+    return moved;
+  }
+
+  int fd_;
+  mode_t mode_;
+  std::array<int, 2> pipe_{-1, -1};
+  // The file was extended for a body that is still being received
+  bool extended_{};
+  off_t original_size_{};
+  uint64_t written_{};
+  std::error_code error_;
+};
+}  // namespace baklaga::http
+#endif  // defined(__linux__)
+
+#endif  // BAKLAGA_HTTP_FILE_SINK_HPP
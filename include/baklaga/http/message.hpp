@@ -2,26 +2,29 @@
 #define BAKLAGA_HTTP_MESSAGE__HPP
 
 #include <cstdint>
-#include <format>
+#include <cstring>
+#include <span>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <type_traits>
+#include <utility>
 
+#include "baklaga/http/concept/buffer.hpp"
 #include "baklaga/http/detail/message.hpp"
 #include "baklaga/http/detail/status_code.hpp"
 #include "baklaga/http/detail/string.hpp"
+#include "baklaga/http/parser.hpp"
 
 namespace baklaga::http {
+using detail::header_id_t;
 using detail::headers_t;
 using detail::method_t;
 using detail::status_code_t;
 
-enum class message_t { request, response };
-
 template <message_t Type, bool Mutable = false>
 class basic_message {
  public:
-  using start_line_t = std::array<std::string_view, 3>;
   using underlying_t =
       std::conditional_t<Mutable, std::string, std::string_view>;
 
@@ -32,19 +35,20 @@ class basic_message {
   basic_message(const basic_message& other) = default;
 
   /// Request constructor
-  basic_message<message_t::request, Mutable>(method_t method,
-                                             std::string_view target,
-                                             uint8_t version, headers_t headers)
+  basic_message(method_t method, std::string_view target, uint8_t version,
+                headers_t headers)
+    requires(Type == message_t::request)
       : method_{method},
         target_{target},
         version_{version},
-        headers_{headers} {}
+        headers_{std::move(headers)} {}
 
   /// Response constructor
-  basic_message<message_t::response, Mutable>(uint8_t version,
-                                              status_code_t status_code,
-                                              headers_t headers)
-      : version_{version}, status_code_{status_code}, headers_{headers} {}
+  basic_message(uint8_t version, status_code_t status_code, headers_t headers)
+    requires(Type == message_t::response)
+      : status_code_{status_code},
+        version_{version},
+        headers_{std::move(headers)} {}
 
   /// Parsing constructor
   basic_message(std::string_view buffer) { parse(buffer); }
@@ -55,56 +59,151 @@ class basic_message {
   }
 
   void parse(std::string_view buffer) {
-    auto start_line_end = buffer.find("\r\n");
-    if (start_line_end == std::string_view::npos) {
+    basic_parser<Type> parser{};
+    if (!parse(buffer, parser)) {
       error_ = std::make_error_code(std::errc::bad_message);
-      return;
-    }
-
-    auto start_line =
-        detail::split_view<3>(buffer.substr(0, start_line_end), " ");
-    if (!parse_start_line(start_line)) {
-      return;
     }
+  }
 
-    if (version_ == detail::type_npos<decltype(version_)>()) {
-      error_ = std::make_error_code(std::errc::protocol_not_supported);
-      return;
+  /// Collects the start line, headers and body reported by `parser`. Views
+  /// refer to the body inside `buffer`; a chunked body is not contiguous
+  /// there, so views skip it (stream::read decodes it in place). Returns
+  /// false if the header block is incomplete, a body cut short is kept as
+  /// far as it was received.
+  bool parse(std::string_view buffer, basic_parser<Type>& parser) {
+    for (;;) {
+      switch (parser.next(buffer)) {
+        case parse_event_t::start_line:
+          // Only the final response is kept, not the interim ones before it
+          headers_.clear();
+          if constexpr (Type == message_t::request) {
+            method_ = parser.method();
+            if (method_ == method_t::extension) {
+              method_name_ = parser.method_name();
+            }
+            target_ = parser.target();
+          } else if constexpr (Type == message_t::response) {
+            status_code_ = parser.status_code();
+          }
+          version_ = parser.version();
+          break;
+        case parse_event_t::header: {
+          auto [name, content] = parser.header();
+          headers_.emplace(parser.header_id(), name, content);
+          break;
+        }
+        case parse_event_t::headers_done:
+          if (!Mutable && parser.chunked()) {
+            return true;
+          }
+          break;
+        case parse_event_t::body:
+          if constexpr (Mutable) {
+            body_.append(parser.body());
+          } else {
+            body_ = buffer.substr(parser.header_size(),
+                                  parser.body_offset() - parser.header_size());
+          }
+          break;
+        case parse_event_t::trailer:
+          break;
+        case parse_event_t::need_more:
+          return parser.header_size() != 0;
+        case parse_event_t::error:
+          error_ = parser.error();
+          return true;
+        default:
+          return true;
+      }
     }
-
-    headers_ = detail::to_headers(
-        buffer.substr(start_line_end + 2,
-                      buffer.find("\r\n\r\n", start_line_end)));
   }
 
-  std::string build() const {
-    std::string result{};
+  /// Exact number of bytes produced by build(): start line, headers, the
+  /// empty line that ends the header block and the body.
+  size_t wire_size() const noexcept {
+    size_t size{};
+    for_each_fragment([&size](std::string_view part) { size += part.size(); });
+    return size;
+  }
 
+  /// Visits the serialized message as a sequence of fragments that point
+  /// into the message itself or into static tables, never into temporary
+  /// storage. Used for vectored writes without an intermediate copy.
+  template <typename VisitorTy>
+  void for_each_fragment(VisitorTy&& visit) const {
     auto version_str = detail::from_version(version_);
     if constexpr (Type == message_t::request) {
-      auto method_str = detail::from_method(method_);
-
-      result =
-          std::format("{:s} {:s} {:s}\r\n", method_str, target_, version_str);
+      if (auto prefix = detail::method_prefix(method_); !prefix.empty()) {
+        visit(prefix);
+      } else {
+        visit(method_name());
+        visit(std::string_view{" "});
+      }
+      visit(std::string_view{target_});
+      visit(std::string_view{" "});
+      visit(version_str);
+      visit(detail::crlf_delimiter);
     } else if constexpr (Type == message_t::response) {
-      auto status_str = detail::from_status_code(status_code_);
-
-      result = std::format("{:s} {:d} {:s}\r\n", version_str,
-                           static_cast<uint16_t>(status_code_), status_str);
+      if (auto line = detail::status_line(version_, status_code_);
+          !line.empty()) {
+        visit(line);
+      } else {
+        visit(version_str);
+        visit(std::string_view{" "});
+        visit(detail::status_code_digits(status_code_));
+        visit(std::string_view{" \r\n"});
+      }
     }
 
     for (const auto& [name, content] : headers_) {
-      result += std::format("{:s}: {:s}\r\n", name, content);
+      visit(std::string_view{name});
+      visit(std::string_view{": "});
+      visit(std::string_view{content});
+      visit(detail::crlf_delimiter);
     }
+    visit(detail::crlf_delimiter);
+    visit(std::string_view{body_});
+  }
 
+  std::string build() const {
+    std::string result{};
+    append_to(result);
     return result;
   }
 
+  /// Serializes into `buffer` and returns the number of bytes written, or
+  /// zero if `buffer` is smaller than wire_size().
+  size_t build(std::span<char> buffer) const noexcept {
+    auto size = wire_size();
+    if (buffer.size() < size) {
+      return 0;
+    }
+    write(buffer.data());
+    return size;
+  }
+
+  /// Appends the serialized message to `buffer`. Clearing a buffer and
+  /// appending again reuses its capacity, so a buffer kept across requests
+  /// stops allocating once it is large enough.
+  template <concept_::ReadBuffer BufferTy>
+  void append_to(BufferTy& buffer) const {
+    auto offset = std::ranges::size(buffer);
+    buffer.resize(offset + wire_size());
+    write(reinterpret_cast<char*>(std::ranges::data(buffer)) + offset);
+  }
+
   auto method() const noexcept
     requires(Type == message_t::request)
   {
     return method_;
   }
+  /// Name of the method, including extension methods
+  std::string_view method_name() const noexcept
+    requires(Type == message_t::request)
+  {
+    return method_ == method_t::extension ? std::string_view{method_name_}
+                                          : detail::from_method(method_);
+  }
   auto status_code() const
     requires(Type == message_t::response)
   {
@@ -117,6 +216,7 @@ class basic_message {
   }
   auto version() const noexcept { return version_; }
   const auto& headers() const noexcept { return headers_; }
+  std::string_view body() const noexcept { return body_; }
   const auto& error() const noexcept { return error_; }
 
   void method(method_t v) noexcept
@@ -124,6 +224,14 @@ class basic_message {
   {
     method_ = v;
   }
+  void method(std::string_view v)
+    requires(Mutable && Type == message_t::request)
+  {
+    method_ = detail::to_method(v);
+    if (method_ == method_t::extension) {
+      method_name_ = v;
+    }
+  }
   auto status_code(status_code_t v) noexcept
     requires(Mutable && Type == message_t::response)
   {
@@ -149,61 +257,27 @@ class basic_message {
   {
     return headers_;
   }
+  /// A view keeps referring to `v`, a mutable message copies it.
+  void body(std::string_view v) { body_ = v; }
   operator std::string() const { return build(); }
 
  private:
-  bool parse_start_line(const start_line_t& start_line) {
-    bool line_parsed{false};
-    if constexpr (Type == message_t::request) {
-      line_parsed = parse_request_start_line(start_line);
-    } else if constexpr (Type == message_t::response) {
-      line_parsed = parse_response_start_line(start_line);
-    }
-
-    if (!line_parsed) {
-      return false;
-    }
-
-    if (version_ == detail::type_npos<decltype(version_)>()) {
-      return set_error(std::errc::protocol_not_supported);
-    }
-
-    return true;
-  }
-
-  bool parse_request_start_line(const start_line_t& start_line) {
-    method_ = detail::to_method(start_line[0]);
-    if (method_ == detail::type_npos<method_t>()) {
-      return set_error(std::errc::operation_not_supported);
-    }
-    target_ = start_line[1];
-    version_ = detail::to_version(start_line[2]);
-
-    return true;
-  }
-
-  bool parse_response_start_line(const start_line_t& start_line) {
-    version_ = detail::to_version(start_line[0]);
-    auto status_code = start_line[1];
-    auto [result, ec] = detail::to_arithmetic<status_code_t>(status_code);
-    if (ec) {
-      return set_error(std::errc::protocol_error);
-    }
-
-    status_code_ = result;
-    return true;
-  }
-
-  bool set_error(std::errc code) noexcept {
-    error_ = std::make_error_code(code);
-    return false;
+  void write(char* out) const noexcept {
+    for_each_fragment([&out](std::string_view part) {
+      if (!part.empty()) {
+        std::memcpy(out, part.data(), part.size());
+        out += part.size();
+      }
+    });
   }
 
   method_t method_;
+  underlying_t method_name_;
   status_code_t status_code_;
   underlying_t target_;
   uint8_t version_;
   headers_t headers_;
+  underlying_t body_;
   std::error_code error_;
 };
 
@@ -211,6 +285,20 @@ using request_view = basic_message<message_t::request>;
 using request = basic_message<message_t::request, true>;
 using response_view = basic_message<message_t::response>;
 using response = basic_message<message_t::response, true>;
+
+namespace detail {
+/// Adds the headers every request sent by a stream needs, unless the caller
+/// already set them.
+inline void fill_basic_data(request& request, std::string_view host,
+                            bool keep_alive) {
+  auto& headers = request.headers();
+  headers.try_emplace(header_id_t::host, host);
+  headers.try_emplace(header_id_t::accept, "*/*");
+  headers.try_emplace(header_id_t::user_agent, "baklaga");
+  headers.try_emplace(header_id_t::connection,
+                      keep_alive ? "keep-alive" : "close");
+}
+}  // namespace detail
 }  // namespace baklaga::http
 
 #endif  // BAKLAGA_HTTP_MESSAGE__HPP
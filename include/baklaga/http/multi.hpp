@@ -0,0 +1,167 @@
+#ifndef BAKLAGA_HTTP_MULTI_HPP
+#define BAKLAGA_HTTP_MULTI_HPP
+
+#include "baklaga/http/epoll.hpp"
+
+#if defined(__linux__)
+#include <deque>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "baklaga/http/async_stream.hpp"
+#include "baklaga/http/buffer_pool.hpp"
+#include "baklaga/http/message.hpp"
+#include "baklaga/http/resolver.hpp"
+#include "baklaga/http/task.hpp"
+#include "baklaga/http/timer_wheel.hpp"
+#include "baklaga/http/uri.hpp"
+
+namespace baklaga::http {
+/// Runs a batch of requests concurrently on a single epoll loop, one
+/// non-blocking connection per request. Each completion is passed to the
+/// callback given to add(), or queued for completions() if there is none.
+/// Header values of added requests are views, their storage has to outlive
+/// run(). Host names are resolved once and cached for the requests after.
+class multi {
+ public:
+  struct options {
+    /// Requests being transferred at the same time, the rest wait
+    size_t max_in_flight = 256;
+    /// Applied to every request, their timers share the wheel of the loop
+    http::deadlines deadlines{};
+  };
+
+  struct completion {
+    /// Value returned by add()
+    size_t id;
+    std::error_code error;
+    /// Points into storage of the multi, valid until clear()
+    http::response_view response;
+  };
+  using callback_t = std::function<void(const completion&)>;
+
+  multi() = default;
+  explicit multi(options opts) : options_{opts} {}
+
+  multi(const multi&) = delete;
+  multi& operator=(const multi&) = delete;
+
+  /// Queues `request` to the server of `uri`. An empty request target is
+  /// taken from the path of `uri`, a missing Host header from its host.
+  /// Returns the id of the request.
+  size_t add(std::string_view uri, http::request request,
+             std::string_view body = {}, callback_t callback = {}) {
+    auto& transfer = transfers_.emplace_back();
+    transfer.buffer = receive_buffer{buffers_};
+    transfer.uri = uri;
+    transfer.request = std::move(request);
+    transfer.body = body;
+    transfer.callback = std::move(callback);
+    http::uri_view view{transfer.uri};
+    if (transfer.request.target().empty()) {
+      auto path = view.path();
+      transfer.request.target(path.empty() ? "/" : path);
+    }
+    // Points into transfer.uri rather than into the connection, which is
+    // gone once the transfer completes
+    transfer.request.headers().try_emplace(header_id_t::host,
+                                           view.authority().hostname());
+    return transfers_.size() - 1;
+  }
+
+  /// Transfers every added request and returns once all of them completed.
+  void run() {
+    start_more();
+    executor_.run();
+  }
+
+  /// Completions of requests added without a callback, in completion order
+  std::span<const completion> completions() const noexcept {
+    return completions_;
+  }
+
+  /// Drops finished requests with their responses. Ids start from zero
+  /// again.
+  void clear() {
+    completions_.clear();
+    transfers_.clear();
+    next_ = 0;
+  }
+
+  /// Resolves hosts with `r` instead of the built-in resolver_cache over
+  /// getaddrinfo; `r` is kept by reference.
+  template <concept_::resolver ResolverTy>
+  void resolver(ResolverTy& r) {
+    use_resolver_ = [&r](async_stream<epoll_socket>& stream) {
+      stream.resolver(r);
+    };
+  }
+
+  epoll_executor& executor() noexcept { return executor_; }
+  size_t in_flight() const noexcept { return in_flight_; }
+
+ private:
+  struct transfer_t {
+    std::string uri;
+    http::request request;
+    std::string body;
+    callback_t callback;
+    receive_buffer buffer;
+  };
+
+  void start_more() {
+    while (in_flight_ < options_.max_in_flight && next_ < transfers_.size()) {
+      ++in_flight_;
+      executor_.spawn(perform(next_++));
+    }
+  }
+
+  task<void> perform(size_t id) {
+    auto& transfer = transfers_[id];
+    completion result{id, {}, {}};
+    {
+      async_stream<epoll_socket> stream{epoll_socket{executor_}};
+      stream.deadlines(options_.deadlines);
+      use_resolver_(stream);
+      result.error = co_await stream.connect(http::uri_view{transfer.uri});
+      if (!result.error) {
+        result.error = co_await stream.write(transfer.request, transfer.body);
+      }
+      if (!result.error) {
+        result.response = co_await stream.read(transfer.buffer, result.error);
+      }
+    }
+
+    --in_flight_;
+    start_more();
+    if (transfer.callback) {
+      transfer.callback(result);
+    } else {
+      completions_.push_back(result);
+    }
+  }
+
+  options options_{};
+  epoll_executor executor_;
+  // Requests to the same host resolve it once
+  resolver_cache<system_resolver> resolver_cache_;
+  std::function<void(async_stream<epoll_socket>&)> use_resolver_{
+      [this](async_stream<epoll_socket>& stream) {
+        stream.resolver(resolver_cache_);
+      }};
+  // Receive buffers of all transfers, used on the thread running the loop
+  buffer_pool buffers_;
+  std::deque<transfer_t> transfers_;
+  std::vector<completion> completions_;
+  size_t next_{};
+  size_t in_flight_{};
+};
+}  // namespace baklaga::http
+#endif  // defined(__linux__)
+
+#endif  // BAKLAGA_HTTP_MULTI_HPP
@@ -0,0 +1,396 @@
+#ifndef BAKLAGA_HTTP_PARSER_HPP
+#define BAKLAGA_HTTP_PARSER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "baklaga/http/chunked.hpp"
+#include "baklaga/http/detail/header_id.hpp"
+#include "baklaga/http/detail/message.hpp"
+#include "baklaga/http/detail/scan.hpp"
+#include "baklaga/http/detail/status_code.hpp"
+#include "baklaga/http/detail/string.hpp"
+
+namespace baklaga::http {
+using detail::body_framing_t;
+using detail::message_t;
+using detail::parse_event_t;
+
+/// Push-style HTTP/1.x parser. The same buffer is passed to every call, grown
+/// with newly received bytes; parsing continues where the previous call
+/// stopped, so no byte is scanned twice. Each call returns one event, views
+/// returned by the accessors point into the last passed buffer. A 1xx
+/// interim response is reported like any other (start_line, header...,
+/// headers_done) and the next call continues with the response after it.
+template <message_t Type>
+class basic_parser {
+ public:
+  using start_line_t = std::array<std::string_view, 3>;
+
+  basic_parser() = default;
+
+  parse_event_t next(std::string_view buffer) {
+    switch (state_) {
+      case state_t::start_line:
+        return next_start_line(buffer);
+      case state_t::headers:
+        return next_header(buffer);
+      case state_t::body:
+        return next_body(buffer);
+      case state_t::done:
+        return parse_event_t::done;
+      case state_t::interim:
+        next_response();
+        return next_start_line(buffer);
+      case state_t::error:
+        break;
+    }
+    return parse_event_t::error;
+  }
+
+  /// Prepares the parser for the next message which starts at `position`.
+  void reset(size_t position = 0) noexcept { *this = basic_parser{position}; }
+
+  /// Method of the request this response answers. Responses to HEAD and
+  /// successful responses to CONNECT have no body whatever their headers
+  /// say, so it has to be set before the header block is parsed.
+  void request_method(detail::method_t method) noexcept
+    requires(Type == message_t::response)
+  {
+    request_method_ = method;
+  }
+
+  /// Tells the parser that the peer closed the connection. Returns true if
+  /// that completes the message, i.e. it ends a close-delimited body.
+  bool finish() noexcept {
+    if (state_ == state_t::body && framing_ == body_framing_t::close) {
+      state_ = state_t::done;
+    }
+    return state_ == state_t::done;
+  }
+
+  auto method() const noexcept
+    requires(Type == message_t::request)
+  {
+    return method_;
+  }
+  auto method_name() const noexcept
+    requires(Type == message_t::request)
+  {
+    return method_name_;
+  }
+  auto target() const noexcept
+    requires(Type == message_t::request)
+  {
+    return target_;
+  }
+  auto status_code() const noexcept
+    requires(Type == message_t::response)
+  {
+    return status_code_;
+  }
+  /// True for a 1xx response other than 101 (Switching Protocols), which
+  /// is not the answer to the request but precedes it
+  bool interim() const noexcept
+    requires(Type == message_t::response)
+  {
+    auto code = static_cast<unsigned>(status_code_);
+    return code >= 100 && code < 200 && code != 101;
+  }
+  auto version() const noexcept { return version_; }
+  const auto& header() const noexcept { return header_; }
+  auto header_id() const noexcept { return header_id_; }
+  auto body() const noexcept { return body_; }
+  auto content_length() const noexcept { return content_length_; }
+  bool chunked() const noexcept { return framing_ == body_framing_t::chunked; }
+  /// Known once headers_done is reported
+  auto framing() const noexcept { return framing_; }
+  /// Offset of the first byte after the header block
+  auto header_size() const noexcept { return body_begin_; }
+  /// Offset of the first body byte not consumed yet, the end of the message
+  /// once done() is true
+  auto body_offset() const noexcept { return body_offset_; }
+
+  /// Tells the parser that the consumed part of the body, [header_size(),
+  /// body_offset()), was removed from the buffer and the following bytes
+  /// were moved down. Used to stream bodies through a bounded buffer.
+  void discard_body() noexcept { body_offset_ = body_begin_; }
+
+  /// Body bytes the parser expects right after body_offset() that carry no
+  /// framing: the rest of a Content-Length body or of the current chunk,
+  /// unlimited for a close-delimited body. Zero outside of the body.
+  uint64_t body_pending() const noexcept {
+    if (state_ != state_t::body) {
+      return 0;
+    }
+    switch (framing_) {
+      case body_framing_t::length:
+        return body_remaining_;
+      case body_framing_t::chunked:
+        return decoder_.pending_data();
+      case body_framing_t::close:
+        return std::numeric_limits<uint64_t>::max();
+      default:
+        return 0;
+    }
+  }
+  /// Accounts for `size` body bytes (at most body_pending()) that were moved
+  /// elsewhere instead of being appended to the buffer.
+  void skip_body(uint64_t size) noexcept {
+    if (framing_ == body_framing_t::length) {
+      body_remaining_ -= static_cast<size_t>(size);
+    } else if (framing_ == body_framing_t::chunked) {
+      decoder_.skip_data(size);
+    }
+  }
+
+  bool done() const noexcept { return state_ == state_t::done; }
+  const auto& error() const noexcept { return error_; }
+
+ private:
+  enum class state_t : uint8_t {
+    start_line,
+    headers,
+    body,
+    done,
+    interim,
+    error
+  };
+
+  explicit basic_parser(size_t position) noexcept : reader_{position} {}
+
+  /// Starts over right after an interim response, for the same request
+  void next_response() noexcept {
+    auto method = request_method_;
+    reset(reader_.position());
+    request_method_ = method;
+  }
+
+  parse_event_t next_start_line(std::string_view buffer) {
+    detail::line_t line{};
+    if (!reader_.next(buffer, line, false)) {
+      return parse_event_t::need_more;
+    }
+
+    auto start_line = detail::split_view<3>(
+        buffer.substr(line.begin, line.end - line.begin), " ");
+    bool line_parsed{false};
+    if constexpr (Type == message_t::request) {
+      line_parsed = parse_request_start_line(start_line);
+    } else if constexpr (Type == message_t::response) {
+      line_parsed = parse_response_start_line(start_line);
+    }
+    if (!line_parsed) {
+      return parse_event_t::error;
+    }
+
+    if (version_ == detail::type_npos<decltype(version_)>()) {
+      return set_error(std::errc::protocol_not_supported);
+    }
+
+    state_ = state_t::headers;
+    return parse_event_t::start_line;
+  }
+
+  parse_event_t next_header(std::string_view buffer) {
+    detail::line_t line{};
+    if (!reader_.next(buffer, line)) {
+      return parse_event_t::need_more;
+    }
+
+    if (line.empty()) {
+      body_begin_ = body_offset_ = reader_.position();
+      body_remaining_ = content_length_;
+      if constexpr (Type == message_t::response) {
+        if (interim()) {
+          framing_ = body_framing_t::none;
+          state_ = state_t::interim;
+          return parse_event_t::headers_done;
+        }
+      }
+      if (!select_framing()) {
+        return set_error(std::errc::bad_message);
+      }
+      state_ = framing_ == body_framing_t::none ? state_t::done : state_t::body;
+      return parse_event_t::headers_done;
+    }
+    if (line.colon == std::string_view::npos || line.colon == line.begin) {
+      return set_error(std::errc::bad_message);
+    }
+
+    auto name = buffer.substr(line.begin, line.colon - line.begin);
+    auto content = detail::trim_ows(
+        buffer.substr(line.colon + 1, line.end - line.colon - 1));
+    header_id_ = detail::to_header_id(name);
+    if (header_id_ == detail::header_id_t::content_length) {
+      // Only 1*DIGIT, neither a list ("1, 1") nor trailing garbage, which
+      // peers could read as another length (RFC 9112 6.3)
+      auto [length, ec] = detail::to_decimal<size_t>(content);
+      if (ec || (has_content_length_ && length != content_length_)) {
+        return set_error(std::errc::bad_message);
+      }
+      content_length_ = length;
+      has_content_length_ = true;
+    } else if (header_id_ == detail::header_id_t::transfer_encoding) {
+      // Only the last transfer coding decides how the body is framed
+      auto last_coding = content.substr(content.rfind(',') + 1);
+      chunked_ = detail::iequals(detail::trim_ows(last_coding), "chunked");
+      has_transfer_encoding_ = true;
+    }
+
+    header_ = {name, content};
+    return parse_event_t::header;
+  }
+
+  /// RFC 9112 6.3, in order of precedence. Returns false if the length of
+  /// a request body cannot be determined or the message has both
+  /// Transfer-Encoding and Content-Length, which is a smuggling attempt
+  /// rather than something to resolve.
+  bool select_framing() noexcept {
+    if (has_transfer_encoding_ && has_content_length_) {
+      return false;
+    }
+    if constexpr (Type == message_t::response) {
+      auto code = static_cast<unsigned>(status_code_);
+      if (request_method_ == detail::method_t::head || code < 200 ||
+          code == 204 || code == 304 ||
+          (request_method_ == detail::method_t::connect && code < 300)) {
+        framing_ = body_framing_t::none;
+        return true;
+      }
+    }
+
+    if (has_transfer_encoding_) {
+      // A response with other codings is read until the connection closes,
+      // a request like that is rejected
+      framing_ = chunked_ ? body_framing_t::chunked : body_framing_t::close;
+      return chunked_ || Type == message_t::response;
+    }
+    if (has_content_length_ && content_length_ != 0) {
+      framing_ = body_framing_t::length;
+    } else if (!has_content_length_ && Type == message_t::response) {
+      framing_ = body_framing_t::close;
+    } else {
+      framing_ = body_framing_t::none;
+    }
+    return true;
+  }
+
+  parse_event_t next_body(std::string_view buffer) {
+    if (framing_ == body_framing_t::chunked) {
+      return next_chunk(buffer);
+    }
+    if (framing_ == body_framing_t::length && body_remaining_ == 0) {
+      state_ = state_t::done;
+      return parse_event_t::done;
+    }
+    if (buffer.size() <= body_offset_) {
+      return parse_event_t::need_more;
+    }
+    if (framing_ == body_framing_t::close) {
+      body_ = buffer.substr(body_offset_);
+      body_offset_ += body_.size();
+      return parse_event_t::body;
+    }
+
+    body_ = buffer.substr(body_offset_, body_remaining_);
+    body_offset_ += body_.size();
+    body_remaining_ -= body_.size();
+    return parse_event_t::body;
+  }
+
+  parse_event_t next_chunk(std::string_view buffer) {
+    size_t consumed{};
+    auto event = decoder_.next(buffer.substr(body_offset_), consumed);
+    body_offset_ += consumed;
+
+    switch (event) {
+      case parse_event_t::body:
+        body_ = decoder_.data();
+        break;
+      case parse_event_t::trailer:
+        header_ = decoder_.trailer();
+        header_id_ = detail::to_header_id(header_.first);
+        break;
+      case parse_event_t::done:
+        state_ = state_t::done;
+        break;
+      case parse_event_t::error:
+        error_ = decoder_.error();
+        state_ = state_t::error;
+        break;
+      default:
+        break;
+    }
+    return event;
+  }
+
+  bool parse_request_start_line(const start_line_t& start_line)
+    requires(Type == message_t::request)
+  {
+    method_name_ = start_line[0];
+    method_ = detail::to_method(method_name_);
+    if (method_ == detail::type_npos<detail::method_t>()) {
+      set_error(std::errc::operation_not_supported);
+      return false;
+    }
+    target_ = start_line[1];
+    version_ = detail::to_version(start_line[2]);
+
+    return true;
+  }
+
+  bool parse_response_start_line(const start_line_t& start_line)
+    requires(Type == message_t::response)
+  {
+    version_ = detail::to_version(start_line[0]);
+    auto digits = start_line[1];
+    auto [result, ec] = detail::to_decimal<uint16_t>(digits);
+    if (ec || digits.size() != 3) {
+      set_error(std::errc::protocol_error);
+      return false;
+    }
+
+    status_code_ = static_cast<detail::status_code_t>(result);
+    return true;
+  }
+
+  parse_event_t set_error(std::errc code) noexcept {
+    error_ = std::make_error_code(code);
+    state_ = state_t::error;
+    return parse_event_t::error;
+  }
+
+  detail::line_reader reader_;
+  state_t state_{state_t::start_line};
+  detail::method_t method_{};
+  detail::status_code_t status_code_{};
+  std::string_view method_name_;
+  std::string_view target_;
+  uint8_t version_{};
+  std::pair<std::string_view, std::string_view> header_;
+  detail::header_id_t header_id_{};
+  std::string_view body_;
+  size_t body_begin_{};
+  size_t body_offset_{};
+  size_t body_remaining_{};
+  size_t content_length_{};
+  bool has_content_length_{};
+  bool has_transfer_encoding_{};
+  bool chunked_{};
+  body_framing_t framing_{};
+  detail::method_t request_method_{detail::method_t::get};
+  chunked_decoder decoder_;
+  std::error_code error_;
+};
+
+using request_parser = basic_parser<message_t::request>;
+using response_parser = basic_parser<message_t::response>;
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_PARSER_HPP
@@ -0,0 +1,476 @@
+#ifndef BAKLAGA_HTTP_RESOLVER_HPP
+#define BAKLAGA_HTTP_RESOLVER_HPP
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "baklaga/http/concept/resolver.hpp"
+#include "baklaga/http/detail/string.hpp"
+
+namespace baklaga::http {
+/// An IPv4 or IPv6 socket address
+class address {
+ public:
+  address() = default;
+  address(const sockaddr* addr, socklen_t size) noexcept {
+    if (addr->sa_family == AF_INET && size >= sizeof(sockaddr_in)) {
+      std::memcpy(&storage_.v4, addr, sizeof(sockaddr_in));
+    } else if (addr->sa_family == AF_INET6 && size >= sizeof(sockaddr_in6)) {
+      std::memcpy(&storage_.v6, addr, sizeof(sockaddr_in6));
+    }
+  }
+
+  /// Parses a numeric IPv4 or IPv6 address
+  static std::optional<address> parse(std::string_view text,
+                                      uint16_t port = 0) {
+    std::array<char, INET6_ADDRSTRLEN> buffer{};
+    if (text.size() >= buffer.size()) {
+      return std::nullopt;
+    }
+    std::memcpy(buffer.data(), text.data(), text.size());
+
+    address result;
+    if (::inet_pton(AF_INET, buffer.data(), &result.storage_.v4.sin_addr) ==
+        1) {
+      result.storage_.v4.sin_family = AF_INET;
+    } else if (::inet_pton(AF_INET6, buffer.data(),
+                           &result.storage_.v6.sin6_addr) == 1) {
+      result.storage_.v6.sin6_family = AF_INET6;
+    } else {
+      return std::nullopt;
+    }
+    result.port(port);
+    return result;
+  }
+
+  /// AF_INET, AF_INET6 or AF_UNSPEC for a default constructed address
+  int family() const noexcept { return storage_.base.sa_family; }
+  const sockaddr* data() const noexcept { return &storage_.base; }
+  socklen_t size() const noexcept {
+    return family() == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+  }
+
+  uint16_t port() const noexcept {
+    return ntohs(family() == AF_INET6 ? storage_.v6.sin6_port
+                                      : storage_.v4.sin_port);
+  }
+  void port(uint16_t v) noexcept {
+    (family() == AF_INET6 ? storage_.v6.sin6_port : storage_.v4.sin_port) =
+        htons(v);
+  }
+
+  /// Numeric host, without the port
+  std::string to_string() const {
+    std::array<char, INET6_ADDRSTRLEN> buffer{};
+    const void* host = family() == AF_INET6
+                           ? static_cast<const void*>(&storage_.v6.sin6_addr)
+                           : &storage_.v4.sin_addr;
+    if (::inet_ntop(family(), host, buffer.data(),
+                    static_cast<socklen_t>(buffer.size())) == nullptr) {
+      return {};
+    }
+    return buffer.data();
+  }
+
+  friend bool operator==(const address& lhs, const address& rhs) noexcept {
+    return lhs.family() == rhs.family() &&
+           std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+  }
+
+ private:
+  union storage_t {
+    sockaddr base;
+    sockaddr_in v4;
+    sockaddr_in6 v6;
+  };
+  storage_t storage_{.v6 = {}};
+};
+
+/// Addresses of a host and how long they may be cached. Copies share the
+/// address list.
+class resolution {
+ public:
+  resolution() = default;
+  resolution(std::vector<address> addresses, std::chrono::seconds ttl)
+      : addresses_{std::make_shared<const std::vector<address>>(
+            std::move(addresses))},
+        ttl_{ttl} {}
+
+  std::span<const address> addresses() const noexcept {
+    return addresses_ ? std::span<const address>{*addresses_}
+                      : std::span<const address>{};
+  }
+  std::chrono::seconds ttl() const noexcept { return ttl_; }
+  bool empty() const noexcept { return addresses().empty(); }
+
+ private:
+  std::shared_ptr<const std::vector<address>> addresses_;
+  std::chrono::seconds ttl_{};
+};
+
+/// Resolves with getaddrinfo. It blocks and does not report record TTLs,
+/// so every answer is given `ttl`.
+class system_resolver {
+ public:
+  explicit system_resolver(std::chrono::seconds ttl = std::chrono::seconds{30})
+      : ttl_{ttl} {}
+
+  resolution resolve(std::string_view host, std::error_code& ec) const {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* list{};
+    if (::getaddrinfo(std::string{host}.c_str(), nullptr, &hints, &list) !=
+        0) {
+      ec = std::make_error_code(std::errc::host_unreachable);
+      return {};
+    }
+
+    std::vector<address> addresses;
+    for (auto* entry = list; entry != nullptr; entry = entry->ai_next) {
+      address found{entry->ai_addr, entry->ai_addrlen};
+      if (found.family() != AF_UNSPEC &&
+          std::find(addresses.begin(), addresses.end(), found) ==
+              addresses.end()) {
+        addresses.push_back(found);
+      }
+    }
+    ::freeaddrinfo(list);
+    return {std::move(addresses), ttl_};
+  }
+
+ private:
+  std::chrono::seconds ttl_;
+};
+
+/// Stub resolver answering from a text file, for tests and fixed setups.
+/// Each line holds a host name, a TTL in seconds and the addresses:
+///
+///     example.com 60 93.184.216.34 2606:2800:220:1:248:1893:25c8:1946
+///
+/// '#' starts a comment. The file is read on every lookup, so answers may
+/// change while it is in use. Unknown names fail with host_unreachable.
+class file_resolver {
+ public:
+  explicit file_resolver(std::string path) : path_{std::move(path)} {}
+
+  resolution resolve(std::string_view host, std::error_code& ec) const {
+    std::string text;
+    if (auto* file = std::fopen(path_.c_str(), "rb")) {
+      std::array<char, 4096> buffer;
+      while (auto size = std::fread(buffer.data(), 1, buffer.size(), file)) {
+        text.append(buffer.data(), size);
+      }
+      std::fclose(file);
+    } else {
+      ec = {errno, std::system_category()};
+      return {};
+    }
+
+    for (std::string_view lines{text}; !lines.empty();) {
+      auto line = lines.substr(0, lines.find('\n'));
+      lines.remove_prefix(std::min(line.size() + 1, lines.size()));
+      auto rest = line.substr(0, line.find('#'));
+      auto next = [&rest] {
+        auto begin = rest.find_first_not_of(" \t\r");
+        if (begin == std::string_view::npos) {
+          rest = {};
+          return std::string_view{};
+        }
+        rest.remove_prefix(begin);
+        auto field = rest.substr(0, rest.find_first_of(" \t\r"));
+        rest.remove_prefix(field.size());
+        return field;
+      };
+
+      if (!detail::iequals(next(), host)) {
+        continue;
+      }
+      auto [ttl, error] = detail::to_arithmetic<uint32_t>(next());
+      if (error) {
+        ec = std::make_error_code(std::errc::bad_message);
+        return {};
+      }
+      std::vector<address> addresses;
+      for (auto field = next(); !field.empty(); field = next()) {
+        if (auto parsed = address::parse(field)) {
+          addresses.push_back(*parsed);
+        }
+      }
+      if (!addresses.empty()) {
+        return {std::move(addresses), std::chrono::seconds{ttl}};
+      }
+    }
+    ec = std::make_error_code(std::errc::host_unreachable);
+    return {};
+  }
+
+ private:
+  std::string path_;
+};
+
+/// Caches the answers of `Resolver` for their TTL. Lookups of a host that
+/// is being resolved wait for that lookup instead of starting another, and
+/// hosts still in use shortly before they expire are resolved again by a
+/// background thread, so steady traffic never waits for a lookup. Entries
+/// are spread over independently locked shards by host name (compared
+/// case-insensitively). Thread-safe, one cache can serve every thread;
+/// `Resolver` is called from several threads at once.
+template <concept_::resolver Resolver>
+class resolver_cache {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  struct options {
+    /// Rounded up to a power of two
+    size_t shards = 16;
+    /// Expired entries are dropped once a shard holds more than this
+    size_t max_entries_per_shard = 1024;
+    std::chrono::seconds min_ttl{0};
+    std::chrono::seconds max_ttl{3600};
+    /// A hit within this share of the TTL before expiry starts a refresh
+    double refresh_ahead = 0.2;
+    bool background_refresh = true;
+  };
+
+  resolver_cache() : resolver_cache(Resolver{}) {}
+  explicit resolver_cache(Resolver backend, options opts = {})
+      : backend_{std::move(backend)},
+        options_{opts},
+        shards_(std::bit_ceil(std::max<size_t>(opts.shards, 1))) {}
+
+  resolver_cache(const resolver_cache&) = delete;
+  resolver_cache& operator=(const resolver_cache&) = delete;
+  ~resolver_cache() {
+    {
+      std::lock_guard lock{refresh_mutex_};
+      stopping_ = true;
+    }
+    refresh_ready_.notify_one();
+    if (refresher_.joinable()) {
+      refresher_.join();
+    }
+  }
+
+  resolution resolve(std::string_view host, std::error_code& ec) {
+    auto& shard = shard_of(host);
+    std::unique_lock lock{shard.mutex};
+    auto it = shard.entries.find(host);
+    if (it != shard.entries.end()) {
+      auto& entry = it->second;
+      auto now = clock::now();
+      if (now < entry.expires) {
+        if (!entry.lookup && now >= entry.refresh_at &&
+            options_.background_refresh) {
+          entry.lookup = std::make_shared<lookup_t>();
+          schedule_refresh(it->first);
+        }
+        return entry.value;
+      } else if (entry.lookup) {
+        // Wait for the lookup already running. Once it is done the entry
+        // may be dropped before this thread gets the lock back, so the
+        // answer is taken from the lookup rather than from the entry.
+        auto lookup = entry.lookup;
+        shard.resolved.wait(lock, [&] { return lookup->done; });
+        if (lookup->value.empty()) {
+          ec = lookup->error;
+        }
+        return lookup->value;
+      }
+    } else {
+      if (shard.entries.size() >= options_.max_entries_per_shard) {
+        evict_expired(shard);
+      }
+      it = shard.entries.try_emplace(std::string{host}).first;
+    }
+
+    // The entry is not dropped while its lookup runs
+    auto& entry = it->second;
+    entry.lookup = std::make_shared<lookup_t>();
+    lock.unlock();
+    std::error_code error;
+    auto result = backend_.resolve(host, error);
+    lock.lock();
+    store(entry, result, error, true);
+    shard.resolved.notify_all();
+    ec = error;
+    return result;
+  }
+
+  /// Drops every entry not being resolved
+  void clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard lock{shard.mutex};
+      std::erase_if(shard.entries,
+                    [](const auto& item) { return !item.second.lookup; });
+    }
+  }
+
+  size_t size() {
+    size_t count{};
+    for (auto& shard : shards_) {
+      std::lock_guard lock{shard.mutex};
+      count += shard.entries.size();
+    }
+    return count;
+  }
+
+  Resolver& backend() noexcept { return backend_; }
+
+ private:
+  /// Case-insensitive FNV-1a, accepting views for lookups
+  struct host_hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view host) const noexcept {
+      uint64_t hash = 14695981039346656037ull;
+      for (auto c : host) {
+        hash = (hash ^ static_cast<uint8_t>(detail::to_lower(c))) *
+               1099511628211ull;
+      }
+      return static_cast<size_t>(hash);
+    }
+  };
+  struct host_equal {
+    using is_transparent = void;
+    bool operator()(std::string_view lhs, std::string_view rhs) const noexcept {
+      return detail::iequals(lhs, rhs);
+    }
+  };
+
+  /// Answer of one lookup for the threads waiting for it
+  struct lookup_t {
+    resolution value;
+    std::error_code error;
+    bool done{};
+  };
+
+  struct entry_t {
+    resolution value;
+    std::error_code error;
+    clock::time_point expires{};
+    clock::time_point refresh_at{};
+    /// Set while a lookup of the host runs, in the foreground or the
+    /// background
+    std::shared_ptr<lookup_t> lookup;
+  };
+
+  struct shard_t {
+    std::mutex mutex;
+    std::condition_variable resolved;
+    std::unordered_map<std::string, entry_t, host_hash, host_equal> entries;
+  };
+
+  shard_t& shard_of(std::string_view host) noexcept {
+    // The low bits pick the bucket inside the shard
+    return shards_[(host_hash{}(host) >> 48) & (shards_.size() - 1)];
+  }
+
+  /// Records a lookup and hands its answer to the threads waiting for it;
+  /// a failed refresh keeps the previous answer until it expires.
+  void store(entry_t& entry, const resolution& result, std::error_code error,
+             bool foreground) {
+    if (error || result.empty()) {
+      if (foreground || clock::now() >= entry.expires) {
+        entry.value = {};
+        entry.error = error ? error
+                            : std::make_error_code(std::errc::host_unreachable);
+        entry.expires = {};
+      }
+    } else {
+      auto ttl = std::clamp(result.ttl(), options_.min_ttl, options_.max_ttl);
+      auto now = clock::now();
+      entry.value = result;
+      entry.error.clear();
+      entry.expires = now + ttl;
+      entry.refresh_at = entry.expires -
+                         std::chrono::duration_cast<clock::duration>(
+                             ttl * options_.refresh_ahead);
+    }
+
+    if (auto lookup = std::exchange(entry.lookup, nullptr)) {
+      lookup->value = entry.value;
+      lookup->error = entry.error;
+      lookup->done = true;
+    }
+  }
+
+  static void evict_expired(shard_t& shard) {
+    auto now = clock::now();
+    std::erase_if(shard.entries, [now](const auto& item) {
+      return !item.second.lookup && item.second.expires <= now;
+    });
+  }
+
+  void schedule_refresh(std::string_view host) {
+    std::lock_guard lock{refresh_mutex_};
+    refresh_queue_.emplace_back(host);
+    if (!refresher_.joinable()) {
+      refresher_ = std::thread{[this] { refresh_loop(); }};
+    }
+    refresh_ready_.notify_one();
+  }
+
+  void refresh_loop() {
+    std::unique_lock lock{refresh_mutex_};
+    for (;;) {
+      refresh_ready_.wait(
+          lock, [this] { return stopping_ || !refresh_queue_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      auto host = std::move(refresh_queue_.back());
+      refresh_queue_.pop_back();
+      lock.unlock();
+
+      std::error_code error;
+      auto result = backend_.resolve(host, error);
+      auto& shard = shard_of(host);
+      {
+        std::lock_guard shard_lock{shard.mutex};
+        if (auto it = shard.entries.find(host); it != shard.entries.end()) {
+          store(it->second, result, error, false);
+        }
+      }
+      shard.resolved.notify_all();
+      lock.lock();
+    }
+  }
+
+  Resolver backend_;
+  options options_;
+  std::vector<shard_t> shards_;
+
+  std::mutex refresh_mutex_;
+  std::condition_variable refresh_ready_;
+  std::vector<std::string> refresh_queue_;
+  bool stopping_{};
+  std::thread refresher_;
+};
+}  // namespace baklaga::http
+#endif  // defined(__linux__)
+
+#endif  // BAKLAGA_HTTP_RESOLVER_HPP
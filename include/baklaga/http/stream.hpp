@@ -1,76 +1,713 @@
 #ifndef BAKLAGA_HTTP_STREAM_HPP
 #define BAKLAGA_HTTP_STREAM_HPP
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <cerrno>
+#endif
+
+#include "baklaga/http/buffer_pool.hpp"
+#include "baklaga/http/chunked.hpp"
+#include "baklaga/http/concept/body.hpp"
 #include "baklaga/http/concept/buffer.hpp"
+#include "baklaga/http/concept/resolver.hpp"
 #include "baklaga/http/concept/socket.hpp"
+#include "baklaga/http/detail/buffer.hpp"
+#include "baklaga/http/detail/response_reader.hpp"
+#include "baklaga/http/detail/scan.hpp"
 #include "baklaga/http/detail/string.hpp"
 #include "baklaga/http/message.hpp"
+#include "baklaga/http/parser.hpp"
+#include "baklaga/http/resolver.hpp"
+#include "baklaga/http/timer_wheel.hpp"
 #include "baklaga/http/uri.hpp"
 
 namespace baklaga::http {
 template <concept_::socket Socket>
 class stream {
  public:
+  using clock = std::chrono::steady_clock;
+
   stream() = default;
   stream(Socket&& socket) : socket_(std::move(socket)) {}
-  ~stream() {}
+  /// Takes the receive buffer of read(std::error_code&) from `pool`, so the
+  /// stream has to stay on the thread of the pool
+  stream(Socket&& socket, buffer_pool& pool)
+      : socket_(std::move(socket)), receive_buffer_{pool} {}
 
   std::error_code connect(http::uri_view uri) {
+    host_ = uri.authority().hostname();
+    auto [port_end, _] =
+        std::to_chars(port_.data(), port_.data() + port_.size(), uri.port());
+    port_size_ = static_cast<size_t>(port_end - port_.data());
+    port_number_ = uri.port();
+    end_request();
+    begin_request();
+    return open_socket();
+  }
+  /// Asks the server to keep the connection open after the response, see
+  /// reusable(). Off by default, requests are sent with "Connection: close".
+  void keep_alive(bool v) noexcept { keep_alive_ = v; }
+  /// True once the last response was read to its end and both sides agreed
+  /// to keep the connection, so the next request may be written right away.
+  bool reusable() const noexcept { return reusable_; }
+  /// Number of requests enqueue() accepts before their responses are read.
+  /// Defaults to 1, i.e. no pipelining.
+  void pipeline_depth(size_t v) noexcept { pipeline_depth_ = v == 0 ? 1 : v; }
+  auto pipeline_depth() const noexcept { return pipeline_depth_; }
+  /// Requests enqueued and not answered yet
+  size_t pending() const noexcept { return pending_.size() - answered_; }
+
+#if defined(__linux__)
+  /// Limits the time of each request. A blocking stream has one operation
+  /// in flight, so rather than arming timers it polls the descriptor before
+  /// each socket call until the nearest deadline; the socket has to return
+  /// data once the descriptor is readable. The connect deadline goes to
+  /// a concept_::timed_connect_socket, otherwise it is applied with
+  /// SO_SNDTIMEO to a descriptor created by open(). An expired deadline
+  /// fails the call with its deadline_error, and the connection cannot be
+  /// reused.
+  void deadlines(const http::deadlines& limits)
+    requires concept_::native_socket<Socket>
+  {
+    deadlines_ = limits;
+  }
+#endif
+  const http::deadlines& deadlines() const noexcept { return deadlines_; }
+
+#if defined(__linux__)
+  /// Resolves hosts with `r` (kept by reference, e.g. a shared
+  /// resolver_cache) and connects to its addresses in order, instead of
+  /// passing the host name to the socket.
+  template <concept_::resolver ResolverTy>
+    requires concept_::address_socket<Socket>
+  void resolver(ResolverTy& r) {
+    resolve_ = [&r](std::string_view host, std::error_code& ec) {
+      return r.resolve(host, ec);
+    };
+  }
+#endif
+
+  /// Queues `request` and `body` for the next flush(). read() returns the
+  /// responses in the order the requests were queued. Fails with
+  /// resource_unavailable_try_again if pipeline_depth() requests are pending.
+  std::error_code enqueue(http::request& request, std::string_view body = {}) {
+    if (pending() >= pipeline_depth_) {
+      return std::make_error_code(std::errc::resource_unavailable_try_again);
+    }
+
+    // Pipelining needs a persistent connection whatever keep_alive() says
+    detail::fill_basic_data(request, host_, true);
+    request.append_to(pipeline_buffer_);
+    pipeline_buffer_.append(body);
+    pending_.push_back({request.method(), pipeline_buffer_.size()});
+    return {};
+  }
+
+  /// Writes every request queued since the last flush with a single write.
+  std::error_code flush() {
+    begin_request();
     std::error_code ec;
-    socket_.open(ec);
-    if (ec) {
+    auto unsent = std::string_view{pipeline_buffer_}.substr(flushed_);
+    write_all(detail::as_bytes(unsent), ec);
+    if (!ec) {
+      flushed_ = pipeline_buffer_.size();
+    }
+    return ec;
+  }
+
+  /// Reconnects and writes again the requests that were flushed but not
+  /// answered. read() does this by itself when the server closes the
+  /// connection before it started the next response and every unanswered
+  /// request is idempotent; others are retried only if the caller knows it
+  /// is safe.
+  std::error_code retry() {
+    std::error_code ec;
+    if (ec = reopen(); ec) {
       return ec;
     }
 
-    socket_.connect(ec);
+    auto begin = answered_ == 0 ? 0 : pending_[answered_ - 1].end;
+    write_all(detail::as_bytes(std::string_view{pipeline_buffer_}.substr(
+                  begin, flushed_ - begin)),
+              ec);
+    return ec;
+  }
+  /// Sends `request` followed by `body`. Sockets with vectored writes get
+  /// the start line, header fragments and body straight from their storage,
+  /// others get a single contiguous copy.
+  ///
+  /// The server may have closed a reused connection while it was idle. If
+  /// writing to it fails, the request is sent once more on a new
+  /// connection. An idempotent request on a reused connection is always
+  /// copied, so read() can send it again as well if the connection turns
+  /// out to be closed before any byte of the response arrived.
+  std::error_code write(http::request& request, std::string_view body = {}) {
+    detail::fill_basic_data(request, host_, keep_alive_);
+    request_method_ = request.method();
+    bool reused = std::exchange(reusable_, false);
+    replayable_ = reused && detail::is_idempotent(request_method_);
+    begin_request();
+
+    std::error_code ec;
+    if constexpr (concept_::vectored_socket<Socket>) {
+      std::array<const_buffer, max_write_buffers> buffers;
+      size_t count{};
+      auto push = [&](std::string_view part) {
+        if (!part.empty() && count < buffers.size()) {
+          buffers[count] = detail::as_bytes(part);
+        }
+        count += part.empty() ? 0 : 1;
+      };
+      request.for_each_fragment(push);
+      push(body);
+
+      if (!replayable_ && count <= buffers.size()) {
+        write_all(std::span{buffers.data(), count}, ec);
+        if (ec && reused && !(ec = reopen())) {
+          write_all(std::span{buffers.data(), count}, ec);
+        }
+        return ec;
+      }
+    }
+
+    write_buffer_.clear();
+    request.append_to(write_buffer_);
+    write_buffer_.append(body);
+    write_all(detail::as_bytes(write_buffer_), ec);
+    if (ec && reused && !(ec = reopen())) {
+      write_all(detail::as_bytes(write_buffer_), ec);
+    }
     return ec;
   }
-  void write(http::request& request) {
-    fill_basic_data(request);
-    socket_.write(request.build());
+  /// Sends `request` with a body pulled from `body`. Unless the request
+  /// already sets Content-Length or Transfer-Encoding, Content-Length is set
+  /// from body.size() when known and the body is sent chunked otherwise;
+  /// the added header is removed again afterwards. The first piece goes out
+  /// together with the header block, file bodies are sent with sendfile
+  /// after it over sockets that opt into it, see concept_::direct_io_socket.
+  template <concept_::body_source BodyTy>
+  std::error_code write(http::request& request, BodyTy&& body) {
+    auto& headers = request.headers();
+    auto size = body.size();
+    bool chunked{};
+    header_id_t added{header_id_t::unknown};
+    if (auto coding = headers.find(header_id_t::transfer_encoding);
+        coding != headers.end()) {
+      chunked = detail::has_token(coding->second, "chunked");
+    } else if (headers.contains(header_id_t::content_length)) {
+      // Framed by the caller
+    } else if (size) {
+      auto [end, _] = std::to_chars(
+          content_length_.data(),
+          content_length_.data() + content_length_.size(), *size);
+      headers.emplace(header_id_t::content_length,
+                      std::string_view{content_length_.data(), end});
+      added = header_id_t::content_length;
+    } else {
+      headers.emplace(header_id_t::transfer_encoding, "chunked");
+      added = header_id_t::transfer_encoding;
+      chunked = true;
+    }
+
+    std::error_code ec;
+    auto sent = write_body(request, body, chunked, ec);
+    // The body source cannot be read again
+    replayable_ = false;
+    if (added != header_id_t::unknown) {
+      headers.erase(added);
+    }
+    if (!ec && !chunked && size && sent != *size) {
+      // The source ended early, the server still waits for the rest
+      ec = std::make_error_code(std::errc::message_size);
+    }
+    return ec;
   }
+
+  /// Receives a response into `buffer`. Bytes already stored in `buffer` are
+  /// treated as the beginning of the response; if `buffer` is passed again
+  /// unchanged, the previous response is dropped from it first, so bytes
+  /// received after its end start the next one. The body of the returned view
+  /// points into `buffer`; a chunked body is decoded in place, right after
+  /// the header block, so it is contiguous as well.
   template <concept_::ReadBuffer BufferTy>
-  http::response_view read(BufferTy& buffer) {
+  http::response_view read(BufferTy& buffer, std::error_code& ec) {
+    auto ignore = [](std::string_view) {};
+    return read_impl(buffer, ignore, false, ec);
+  }
+
+  /// Receives a response into the receive buffer of the connection, which
+  /// is kept across requests and comes from the buffer_pool given to the
+  /// constructor, if any. The view is valid until the next read.
+  http::response_view read(std::error_code& ec) {
+    return read(receive_buffer_, ec);
+  }
+
+  /// Receives a response, passing the decoded body to `sink` piece by piece.
+  /// Consumed body bytes are dropped from `buffer`, so bodies of any size
+  /// (e.g. long chunked streams) pass through a buffer of bounded size.
+  template <concept_::ReadBuffer BufferTy, typename SinkTy>
+    requires std::invocable<SinkTy&, std::string_view>
+  http::response_view read(BufferTy& buffer, SinkTy&& sink,
+                           std::error_code& ec) {
+    return read_impl(buffer, sink, true, ec);
+  }
+
+  /// Sends a part of a body framed with the chunked transfer coding; the
+  /// request must have been sent with "Transfer-Encoding: chunked".
+  std::error_code write_chunk(std::string_view chunk) {
     std::error_code ec;
+    replayable_ = false;
+    if (chunk.empty()) {
+      return ec;
+    }
+
+    auto header = encoder_.chunk_header(chunk.size());
+    if constexpr (concept_::vectored_socket<Socket>) {
+      std::array<const_buffer, 3> buffers{
+          detail::as_bytes(header), detail::as_bytes(chunk),
+          detail::as_bytes(chunked_encoder::chunk_end)};
+      write_all(std::span{buffers}, ec);
+    } else {
+      write_buffer_.clear();
+      encoder_.append_chunk(write_buffer_, chunk);
+      write_all(detail::as_bytes(write_buffer_), ec);
+    }
+    return ec;
+  }
 
-    while (!buffer.contains("\r\n\r\n")) {
-      auto bytes_incoming = socket_.available();
-      auto end_of_previous_data = buffer.size();
-      buffer.resize(buffer.size() + bytes_incoming);
+  /// Ends a chunked body.
+  std::error_code write_last_chunk() {
+    std::error_code ec;
+    replayable_ = false;
+    write_all(detail::as_bytes(chunked_encoder::last_chunk), ec);
+    return ec;
+  }
+
+  /// Closes the connection, errors are ignored since nothing is left to do
+  /// with the socket afterwards.
+  void shutdown() {
+    std::error_code ec;
+    socket_.shutdown(ec);
+    socket_.close(ec);
+    reusable_ = false;
+  }
+
+ private:
+  template <concept_::ReadBuffer BufferTy, typename SinkTy>
+  http::response_view read_impl(BufferTy& buffer, SinkTy& sink,
+                                bool discard_body, std::error_code& ec) {
+    cursor_.drop(buffer);
+
+    bool pipelined = pending() != 0;
+    detail::response_reader reader{pipelined ? pending_[answered_].method
+                                             : request_method_};
+    auto on_body = [&](std::string_view piece) {
+      if (discard_body) {
+        sink(piece);
+      } else {
+        reader.gather_body(reinterpret_cast<char*>(std::ranges::data(buffer)),
+                           piece);
+      }
+    };
+    size_t received = std::ranges::size(buffer);
+    bool retried{};
+    begin_request();
+    if (received == 0 && deadlines_.first_byte.count() != 0) {
+      first_byte_end_ = clock::now() + deadlines_.first_byte;
+    }
+
+    for (;;) {
+      auto event = reader.next(detail::as_view(buffer, received), on_body);
+      if (event == parse_event_t::done) {
+        break;
+      } else if (event == parse_event_t::error) {
+        ec = reader.parser().error();
+        end_request();
+        return {};
+      }
+
+      if (discard_body) {
+        received = reader.discard_body(
+            reinterpret_cast<char*>(std::ranges::data(buffer)), received);
+      }
+      if (!wait_ready(false, ec)) {
+        return {};
+      }
 
-      auto buffer_span = std::span<uint8_t>(buffer);
-      auto read_buffer = buffer_span.subspan(end_of_previous_data);
-      auto bytes_readed = socket_.read(read_buffer, ec);
-      if (bytes_readed == 0 || ec) {
+      size_t bytes_read{};
+      size_t read_size = read_chunk_size;
+      if constexpr (concept_::direct_io_socket<Socket> &&
+                    concept_::direct_sink<SinkTy>) {
+        // The payload goes from the socket to the sink, only the header
+        // block and chunk headers pass through the buffer
+        auto& parser = reader.parser();
+        if (parser.body_offset() == received && parser.body_pending() != 0) {
+          bytes_read = static_cast<size_t>(sink.transfer(
+              socket_.native_handle(), parser.body_pending(), ec));
+          reader.skip_body(bytes_read);
+          read_size = 0;
+        } else if (parser.chunked()) {
+          read_size = chunk_header_read_size;
+        }
+      }
+      if (read_size != 0) {
+        bytes_read = socket_.read(
+            detail::receive_space(buffer, received, read_size), ec);
+        received += bytes_read;
+        buffer.resize(received);
+      }
+      if (!ec && bytes_read != 0) {
+        first_byte_end_ = clock::time_point::max();
+        continue;
+      } else if (!ec && reader.finish()) {
+        // End of stream completes a close-delimited body
         break;
       }
+
+      // The server may close a persistent connection before it answers the
+      // next request, which is safe to repeat only if no part of the
+      // response arrived
+      if (received == 0 && !retried && pending() != 0 && retry_safe()) {
+        retried = true;
+        if (ec = retry(); !ec) {
+          continue;
+        }
+      } else if (received == 0 && !retried && !pipelined && replayable_) {
+        // Same for a single request on a reused connection, see write()
+        retried = true;
+        if (ec = reopen(); !ec) {
+          write_all(detail::as_bytes(write_buffer_), ec);
+        }
+        if (!ec) {
+          continue;
+        }
+      }
+      if (!ec) {
+        ec = std::make_error_code(std::errc::connection_aborted);
+      }
+      end_request();
+      return {};
     }
 
-    http::response_view response{buffer};
-    auto [content_length, ec] =
-        detail::to_arithmetic<int>(response.headers().at("Content-Length"));
+    end_request();
+    if (pipelined && ++answered_ == pending_.size()) {
+      pending_.clear();
+      pipeline_buffer_.clear();
+      answered_ = flushed_ = 0;
+    }
+    cursor_.consumed(buffer, reader.parser().body_offset());
+    reusable_ = (keep_alive_ || pipelined) && reader.persistent();
+    if constexpr (requires { sink.error(); }) {
+      if (sink.error()) {
+        ec = sink.error();
+      }
+    }
+
+    return reader.response(detail::as_view(buffer, received));
+  }
+
+  /// Writes the request followed by the body, returns the body bytes sent.
+  template <typename BodyTy>
+  uint64_t write_body(http::request& request, BodyTy& body, bool chunked,
+                      std::error_code& ec) {
+    uint64_t sent{};
+    if constexpr (concept_::direct_io_socket<Socket> &&
+                  concept_::direct_body<BodyTy>) {
+      if (!chunked) {
+        if (ec = write(request); ec) {
+          return sent;
+        }
+        while (wait_ready(true, ec)) {
+          auto moved = body.transfer(socket_.native_handle(), ec);
+          if (moved == 0) {
+            break;
+          }
+          sent += moved;
+        }
+        return sent;
+      }
+    }
+
+    auto piece = body.read(ec);
     if (ec) {
-      return response;
+      return sent;
+    } else if (ec = write(request, chunked ? std::string_view{} : piece); ec) {
+      return sent;
     }
+    for (bool first = true; !piece.empty();
+         piece = body.read(ec), first = false) {
+      if (chunked) {
+        ec = write_chunk(piece);
+      } else if (!first) {
+        write_all(detail::as_bytes(piece), ec);
+      }
+      if (ec) {
+        return sent;
+      }
+      sent += piece.size();
+    }
+    if (!ec && chunked) {
+      ec = write_last_chunk();
+    }
+    return sent;
+  }
+
+  /// Closes the socket and connects again to the same server
+  std::error_code reopen() {
+    std::error_code ec;
+    socket_.close(ec);
+    return open_socket();
+  }
 
-    buffer.resize(buffer.size() + content_length);
-    socket_.read(buffer.data() + content_length, ec);
+  struct pending_t {
+    method_t method;
+    size_t end;  // end of the serialized request in pipeline_buffer_
+  };
 
-    return response;
+  std::error_code open_socket() {
+    reusable_ = false;
+#if defined(__linux__)
+    if constexpr (concept_::address_socket<Socket>) {
+      if (resolve_) {
+        std::error_code ec;
+        auto found = resolve_(host_, ec);
+        if (!ec && found.empty()) {
+          ec = std::make_error_code(std::errc::host_unreachable);
+        }
+        bool first = true;
+        for (auto address : found.addresses()) {
+          if (!std::exchange(first, false)) {
+            std::error_code ignored;
+            socket_.close(ignored);
+          }
+          address.port(port_number_);
+          ec = connect_socket([&](std::error_code& error) {
+            socket_.connect(address, error);
+          });
+          if (!ec || ec.category() == deadline_category()) {
+            break;
+          }
+        }
+        return ec;
+      }
+    }
+#endif
+    return connect_socket([&](std::error_code& error) {
+      socket_.connect(host_, std::string_view{port_.data(), port_size_},
+                      error);
+    });
   }
-  void shutdown() {}
 
- private:
-  void fill_basic_data(http::request& request) {
-    auto& headers = request.headers();
-    headers.try_emplace("Host", uri_.authority().hostname());
-    headers.try_emplace("Accept", "*/*");
-    headers.try_emplace("User-Agent", "baklaga");
-    headers.try_emplace("Connection", "close");
+  /// Opens the socket and calls `connect(ec)` under the connect deadline.
+  template <typename ConnectFn>
+  std::error_code connect_socket(ConnectFn&& connect) {
+    std::error_code ec;
+    socket_.open(ec);
+    if (ec) {
+      return ec;
+    }
+
+#if defined(__linux__)
+    if constexpr (concept_::native_socket<Socket>) {
+      auto now = clock::now();
+      auto end = deadlines_.connect.count() != 0 ? now + deadlines_.connect
+                                                 : clock::time_point::max();
+      auto kind = deadline_error::connect;
+      if (total_end_ < end) {
+        end = total_end_;
+        kind = deadline_error::total;
+      }
+      if (end != clock::time_point::max()) {
+        auto left = std::chrono::ceil<std::chrono::microseconds>(end - now);
+        if (left.count() <= 0) {
+          return expired(kind);
+        }
+        if constexpr (concept_::timed_connect_socket<Socket>) {
+          socket_.connect_timeout(left);
+          connect(ec);
+          socket_.connect_timeout({});
+        } else if (int fd = socket_.native_handle(); fd >= 0) {
+          // Linux applies the send timeout to a blocking connect()
+          timeval limit{static_cast<time_t>(left.count() / 1'000'000),
+                        static_cast<suseconds_t>(left.count() % 1'000'000)};
+          timeval previous{};
+          socklen_t size = sizeof(previous);
+          ::getsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &previous, &size);
+          ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+          connect(ec);
+          ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &previous,
+                       sizeof(previous));
+        } else {
+          connect(ec);
+        }
+        if (ec && (ec == std::errc::timed_out ||
+                   ec == std::errc::operation_in_progress ||
+                   ec == std::errc::resource_unavailable_try_again ||
+                   clock::now() >= end)) {
+          return expired(kind);
+        }
+        return ec;
+      }
+    }
+#endif
+
+    connect(ec);
+    return ec;
+  }
+
+  /// Starts the total deadline unless the request already runs
+  void begin_request() noexcept {
+    if (total_end_ == clock::time_point::max() &&
+        deadlines_.total.count() != 0) {
+      total_end_ = clock::now() + deadlines_.total;
+    }
+  }
+  void end_request() noexcept {
+    total_end_ = first_byte_end_ = clock::time_point::max();
+  }
+  std::error_code expired(deadline_error kind) noexcept {
+    end_request();
+    reusable_ = false;
+    return make_error_code(kind);
+  }
+
+  /// Waits until the socket is ready for the next call, or fails with the
+  /// deadline_error of the nearest deadline once it passes. Idle time is not
+  /// counted while waiting for the first byte of a response.
+  bool wait_ready(bool write, std::error_code& ec) {
+#if defined(__linux__)
+    if constexpr (concept_::native_socket<Socket>) {
+      if (!deadlines_) {
+        return true;
+      }
+      auto now = clock::now();
+      auto end = clock::time_point::max();
+      auto kind = deadline_error::idle;
+      if (first_byte_end_ != clock::time_point::max()) {
+        end = first_byte_end_;
+        kind = deadline_error::first_byte;
+      } else if (deadlines_.idle.count() != 0) {
+        end = now + deadlines_.idle;
+      }
+      if (total_end_ < end) {
+        end = total_end_;
+        kind = deadline_error::total;
+      }
+      if (end == clock::time_point::max()) {
+        return true;
+      }
+
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(end - now);
+      auto wait = std::clamp<int64_t>(left.count(), 0, INT32_MAX);
+      pollfd descriptor{socket_.native_handle(),
+                        static_cast<short>(write ? POLLOUT : POLLIN), 0};
+      int result{};
+      do {
+        result = ::poll(&descriptor, 1, static_cast<int>(wait));
+      } while (result < 0 && errno == EINTR);
+      if (result == 0) {
+        ec = expired(kind);
+        return false;
+      }
+    }
+#endif
+    (void)write;
+    (void)ec;
+    return true;
+  }
+
+  bool retry_safe() const noexcept {
+    return std::all_of(pending_.begin() + answered_,
+                       pending_.begin() + pending_.size(),
+                       [](const pending_t& p) {
+                         return detail::is_idempotent(p.method);
+                       });
+  }
+
+  static constexpr size_t read_chunk_size = 4096;
+  static constexpr size_t chunk_header_read_size = 32;
+  static constexpr size_t max_write_buffers = 128;
+
+  void write_all(const_buffer buffer, std::error_code& ec) {
+    while (!buffer.empty() && wait_ready(true, ec)) {
+      auto written = socket_.write(buffer, ec);
+      if (ec) {
+        return;
+      } else if (written == 0) {
+        ec = std::make_error_code(std::errc::connection_aborted);
+        return;
+      }
+      buffer = buffer.subspan(written);
+    }
+  }
+
+  void write_all(std::span<const_buffer> buffers, std::error_code& ec)
+    requires concept_::vectored_socket<Socket>
+  {
+    while (!buffers.empty() && wait_ready(true, ec)) {
+      auto written = socket_.write(std::span<const const_buffer>{buffers}, ec);
+      if (ec) {
+        return;
+      } else if (written == 0) {
+        ec = std::make_error_code(std::errc::connection_aborted);
+        return;
+      }
+
+      // Drop fully written buffers and trim the partially written one
+      while (!buffers.empty() && written >= buffers.front().size()) {
+        written -= buffers.front().size();
+        buffers = buffers.subspan(1);
+      }
+      if (!buffers.empty()) {
+        buffers.front() = buffers.front().subspan(written);
+      }
+    }
   }
 
   Socket socket_;
-  http::uri_view uri_;
+  std::string host_;
+  std::array<char, 8> port_{};
+  size_t port_size_{};
+  uint16_t port_number_{};
+  bool keep_alive_{};
+  bool reusable_{};
+  size_t pipeline_depth_{1};
+  std::string pipeline_buffer_;
+  std::vector<pending_t> pending_;
+  size_t answered_{};
+  size_t flushed_{};
+  detail::receive_cursor cursor_;
+  receive_buffer receive_buffer_;
+  method_t request_method_{method_t::get};
+  // The last request is in write_buffer_ and may be sent again
+  bool replayable_{};
+  std::string write_buffer_;
+  std::array<char, 20> content_length_{};
+  chunked_encoder encoder_;
+  http::deadlines deadlines_;
+#if defined(__linux__)
+  std::function<resolution(std::string_view, std::error_code&)> resolve_;
+#endif
+  clock::time_point total_end_{clock::time_point::max()};
+  clock::time_point first_byte_end_{clock::time_point::max()};
 };
 }  // namespace baklaga::http
 
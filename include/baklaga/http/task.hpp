@@ -0,0 +1,135 @@
+#ifndef BAKLAGA_HTTP_TASK_HPP
+#define BAKLAGA_HTTP_TASK_HPP
+
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace baklaga::http {
+template <typename Ty = void>
+class task;
+
+namespace detail {
+template <typename Ty>
+struct task_result {
+  void return_value(Ty value) noexcept(
+      std::is_nothrow_move_constructible_v<Ty>) {
+    ::new (static_cast<void*>(&value_)) Ty(std::move(value));
+    has_value_ = true;
+  }
+  Ty take() { return std::move(*std::launder(reinterpret_cast<Ty*>(&value_))); }
+  ~task_result() {
+    if (has_value_) {
+      std::launder(reinterpret_cast<Ty*>(&value_))->~Ty();
+    }
+  }
+
+  alignas(Ty) unsigned char value_[sizeof(Ty)];
+  bool has_value_{};
+};
+
+template <>
+struct task_result<void> {
+  void return_void() noexcept {}
+  void take() noexcept {}
+};
+
+template <typename Ty>
+struct task_promise : task_result<Ty> {
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<task_promise> handle) noexcept {
+      auto& promise = handle.promise();
+      if (promise.detached_) {
+        if (promise.exception_) {
+          std::terminate();
+        }
+        handle.destroy();
+        return std::noop_coroutine();
+      }
+      return promise.continuation_;
+    }
+    void await_resume() const noexcept {}
+  };
+
+  task<Ty> get_return_object() noexcept;
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  final_awaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+  std::coroutine_handle<> continuation_{std::noop_coroutine()};
+  std::exception_ptr exception_;
+  bool detached_{};
+};
+}  // namespace detail
+
+/// Lazily started coroutine. Awaiting it runs the body and resumes the
+/// awaiting coroutine right from its final suspend point, so chains of tasks
+/// neither grow the stack nor go through a scheduler. The frame is the only
+/// allocation, exceptions are rethrown to the awaiting coroutine.
+template <typename Ty>
+class [[nodiscard]] task {
+ public:
+  using promise_type = detail::task_promise<Ty>;
+  using handle_t = std::coroutine_handle<promise_type>;
+
+  task() = default;
+  explicit task(handle_t handle) noexcept : handle_{handle} {}
+  task(task&& other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      reset();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  ~task() { reset(); }
+
+  bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation_ = awaiting;
+    return handle_;
+  }
+  /// A default-constructed or moved-from task has nothing to await.
+  Ty await_resume() {
+    assert(handle_ && "awaiting an empty task");
+    auto& promise = handle_.promise();
+    if (promise.exception_) {
+      std::rethrow_exception(promise.exception_);
+    }
+    return promise.take();
+  }
+
+  /// Gives up ownership and returns the handle of a task that destroys
+  /// itself once it completes. An exception escaping it terminates the
+  /// program, like one escaping a thread.
+  std::coroutine_handle<> detach() noexcept {
+    assert(handle_ && "detaching an empty task");
+    handle_.promise().detached_ = true;
+    return std::exchange(handle_, {});
+  }
+
+  explicit operator bool() const noexcept { return bool(handle_); }
+
+ private:
+  void reset() noexcept {
+    if (handle_) {
+      std::exchange(handle_, {}).destroy();
+    }
+  }
+
+  handle_t handle_;
+};
+
+template <typename Ty>
+task<Ty> detail::task_promise<Ty>::get_return_object() noexcept {
+  return task<Ty>{std::coroutine_handle<task_promise>::from_promise(*this)};
+}
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_TASK_HPP
@@ -0,0 +1,264 @@
+#ifndef BAKLAGA_HTTP_TIMER_WHEEL_HPP
+#define BAKLAGA_HTTP_TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace baklaga::http {
+/// Deadline that ended a request, compares equal to std::errc::timed_out.
+enum class deadline_error {
+  connect = 1,
+  first_byte,
+  idle,
+  total,
+};
+
+namespace detail {
+class deadline_category_t : public std::error_category {
+ public:
+  const char* name() const noexcept override { return "baklaga.deadline"; }
+
+  std::string message(int value) const override {
+    switch (static_cast<deadline_error>(value)) {
+      case deadline_error::connect:
+        return "connect deadline expired";
+      case deadline_error::first_byte:
+        return "first byte deadline expired";
+      case deadline_error::idle:
+        return "idle deadline expired";
+      case deadline_error::total:
+        return "total deadline expired";
+    }
+    return "unknown deadline";
+  }
+
+  std::error_condition default_error_condition(
+      int) const noexcept override {
+    return std::errc::timed_out;
+  }
+};
+}  // namespace detail
+
+inline const std::error_category& deadline_category() noexcept {
+  static const detail::deadline_category_t category;
+  return category;
+}
+
+inline std::error_code make_error_code(deadline_error e) noexcept {
+  return {static_cast<int>(e), deadline_category()};
+}
+
+/// Per-request time limits, zero disables a limit. An expired deadline
+/// aborts the pending operation with its deadline_error.
+struct deadlines {
+  using duration = std::chrono::steady_clock::duration;
+
+  /// Until the connection is established
+  duration connect{};
+  /// From the start of reading until the first byte of the response
+  duration first_byte{};
+  /// Without any progress while writing the request or reading the
+  /// response after its first byte
+  duration idle{};
+  /// From connect (or the first write on a reused connection) until the
+  /// response is read
+  duration total{};
+
+  explicit operator bool() const noexcept {
+    return connect.count() != 0 || first_byte.count() != 0 ||
+           idle.count() != 0 || total.count() != 0;
+  }
+};
+
+/// Hashed timer wheel: time is cut into ticks of `resolution` and a timer
+/// is linked into the slot of its tick modulo the slot count, so arming
+/// and cancelling a timer are O(1) and allocation-free whatever the number
+/// of timers. Timers further away than one revolution stay in their slot
+/// for later rounds. Timers never fire early, and at most one tick late
+/// plus the time the owner takes to call advance(). Not thread-safe, one
+/// wheel is shared by everything running on an executor.
+class timer_wheel {
+  struct hook {
+    hook* prev{this};
+    hook* next{this};
+  };
+
+ public:
+  using clock = std::chrono::steady_clock;
+
+  struct options {
+    clock::duration resolution = std::chrono::milliseconds{1};
+    /// Rounded up to a power of two
+    size_t slots = 4096;
+  };
+
+  /// Intrusive timer owned by the caller, unlinked when destroyed.
+  /// `expire(timer&)` is called by advance() once the timer is due; the
+  /// timer is disarmed by then and may be armed again from the callback.
+  class timer : hook {
+   public:
+    explicit timer(void (*expire)(timer&)) noexcept : expire_{expire} {}
+    timer(const timer&) = delete;
+    timer& operator=(const timer&) = delete;
+    ~timer() { cancel(); }
+
+    bool armed() const noexcept { return wheel_ != nullptr; }
+    void cancel() noexcept {
+      if (wheel_ != nullptr) {
+        wheel_->cancel(*this);
+      }
+    }
+
+   private:
+    friend class timer_wheel;
+
+    void (*expire_)(timer&);
+    timer_wheel* wheel_{};
+    uint64_t tick_{};
+  };
+
+  timer_wheel() : timer_wheel(options{}) {}
+  explicit timer_wheel(options opts)
+      : resolution_{std::max(opts.resolution, clock::duration{1})},
+        slots_(std::bit_ceil(std::max<size_t>(opts.slots, 1))),
+        mask_{slots_.size() - 1},
+        origin_{clock::now()} {}
+
+  timer_wheel(const timer_wheel&) = delete;
+  timer_wheel& operator=(const timer_wheel&) = delete;
+  ~timer_wheel() {
+    for (auto& slot : slots_) {
+      while (slot.next != &slot) {
+        cancel(static_cast<timer&>(*slot.next));
+      }
+    }
+  }
+
+  /// Arms `t` to fire at `deadline`, re-arming it if it already is.
+  void schedule(timer& t, clock::time_point deadline) noexcept {
+    t.cancel();
+    auto since = deadline - origin_;
+    auto tick = since.count() <= 0
+                    ? uint64_t{0}
+                    : static_cast<uint64_t>((since + resolution_ -
+                                             clock::duration{1}) /
+                                            resolution_);
+    t.tick_ = std::max(tick, current_ + 1);
+    link(slots_[t.tick_ & mask_], t);
+    t.wheel_ = this;
+    ++size_;
+  }
+  void schedule(timer& t, clock::duration after) noexcept {
+    schedule(t, clock::now() + after);
+  }
+
+  void cancel(timer& t) noexcept {
+    if (t.wheel_ != this) {
+      return;
+    }
+    unlink(t);
+    t.wheel_ = nullptr;
+    --size_;
+  }
+
+  /// Fires the timers due at `now`, returns how many fired.
+  size_t advance(clock::time_point now = clock::now()) {
+    auto target = tick_of(now);
+    if (target <= current_ || size_ == 0) {
+      current_ = std::max(current_, target);
+      return 0;
+    }
+
+    // Collect first, so callbacks may cancel or arm any timer meanwhile
+    hook expired;
+    auto steps = std::min<uint64_t>(target - current_, slots_.size());
+    for (uint64_t step = 1; step <= steps; ++step) {
+      auto& slot = slots_[(current_ + step) & mask_];
+      for (auto* node = slot.next; node != &slot;) {
+        auto& t = static_cast<timer&>(*node);
+        node = node->next;
+        if (t.tick_ <= target) {
+          unlink(t);
+          link(expired, t);
+        }
+      }
+    }
+    current_ = target;
+
+    size_t fired{};
+    while (expired.next != &expired) {
+      auto& t = static_cast<timer&>(*expired.next);
+      cancel(t);
+      t.expire_(t);
+      ++fired;
+    }
+    return fired;
+  }
+
+  /// Milliseconds until advance() may have a timer to fire, for the
+  /// timeout of epoll_wait and the like; -1 without timers. Looks ahead a
+  /// bounded number of slots and returns that distance if they are empty,
+  /// so a far timer costs an early wakeup rather than a full scan.
+  int timeout_ms(clock::time_point now = clock::now()) const noexcept {
+    if (size_ == 0) {
+      return -1;
+    }
+    auto steps = std::min<uint64_t>(lookahead, slots_.size());
+    uint64_t step = 1;
+    while (step < steps &&
+           slots_[(current_ + step) & mask_].next ==
+               &slots_[(current_ + step) & mask_]) {
+      ++step;
+    }
+    auto due = origin_ + resolution_ * static_cast<int64_t>(current_ + step);
+    if (due <= now) {
+      return 0;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - now);
+    return static_cast<int>(std::min<int64_t>(wait.count(), INT32_MAX));
+  }
+
+  /// Armed timers
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  clock::duration resolution() const noexcept { return resolution_; }
+
+ private:
+  static constexpr uint64_t lookahead = 256;
+
+  uint64_t tick_of(clock::time_point time) const noexcept {
+    auto since = time - origin_;
+    return since.count() <= 0 ? 0 : static_cast<uint64_t>(since / resolution_);
+  }
+
+  static void link(hook& list, hook& node) noexcept {
+    node.prev = list.prev;
+    node.next = &list;
+    list.prev->next = &node;
+    list.prev = &node;
+  }
+  static void unlink(hook& node) noexcept {
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    node.prev = node.next = &node;
+  }
+
+  clock::duration resolution_;
+  std::vector<hook> slots_;
+  uint64_t mask_;
+  clock::time_point origin_;
+  uint64_t current_{};
+  size_t size_{};
+};
+}  // namespace baklaga::http
+
+template <>
+struct std::is_error_code_enum<baklaga::http::deadline_error> : true_type {};
+
+#endif  // BAKLAGA_HTTP_TIMER_WHEEL_HPP
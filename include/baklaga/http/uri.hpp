@@ -1,16 +1,109 @@
 #ifndef BAKLAGA_HTTP_URI_HPP
 #define BAKLAGA_HTTP_URI_HPP
 
+#include <charconv>
+#include <cstddef>
 #include <cstdint>
 #include <format>
-#include <ranges>
+#include <functional>
+#include <iterator>
+#include <optional>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
 
 #include "baklaga/http/detail/string.hpp"
+#include "baklaga/http/uri_encode.hpp"
 
 namespace baklaga::http {
+namespace detail {
+/// Decimal port of an authority, 0 unless `str` consists of digits only
+/// and fits into 16 bits.
+[[nodiscard]] constexpr uint16_t to_port(std::string_view str) noexcept {
+  uint32_t value = 0;
+  for (auto c : str) {
+    if (c < '0' || c > '9') {
+      return 0;
+    }
+    value = value * 10 + static_cast<uint32_t>(c - '0');
+    if (value > 0xffff) {
+      return 0;
+    }
+  }
+  return static_cast<uint16_t>(value);
+}
+
+/// Checks `buffer` against the URI syntax that basic_uri splits, stricter
+/// than parse() itself: only characters allowed by RFC 3986 2 with valid
+/// escapes, a well-formed scheme, a non-empty host after "://", a numeric
+/// port in range and at most one '#'.
+[[nodiscard]] constexpr bool valid_uri(std::string_view buffer) noexcept {
+  constexpr std::string_view delimiters = ":/?#[]@!$&'()*+,;=";
+  if (buffer.empty()) {
+    return false;
+  }
+  bool fragment = false;
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    auto c = buffer[i];
+    if (c == '%') {
+      if (buffer.size() - i < 3 ||
+          (hex_value_table[static_cast<uint8_t>(buffer[i + 1])] |
+           hex_value_table[static_cast<uint8_t>(buffer[i + 2])]) > 0xf) {
+        return false;
+      }
+      i += 2;
+    } else if (c == '#') {
+      if (std::exchange(fragment, true)) {
+        return false;
+      }
+    } else if (!is_unreserved(c) &&
+               delimiters.find(c) == std::string_view::npos) {
+      return false;
+    }
+  }
+
+  auto rest = buffer;
+  auto scheme_end = buffer.find("://");
+  if (scheme_end != std::string_view::npos) {
+    auto scheme = buffer.substr(0, scheme_end);
+    auto is_alpha = [](char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    };
+    if (scheme.empty() || !is_alpha(scheme.front())) {
+      return false;
+    }
+    for (auto c : scheme) {
+      if (!is_alpha(c) && !(c >= '0' && c <= '9') && c != '+' && c != '-' &&
+          c != '.') {
+        return false;
+      }
+    }
+    rest.remove_prefix(scheme_end + 3);
+  }
+
+  auto authority = rest.substr(0, rest.find_first_of("/?#"));
+  if (auto at = authority.rfind('@'); at != std::string_view::npos) {
+    authority.remove_prefix(at + 1);
+  }
+  auto colon = authority.find(':');
+  auto host = authority.substr(0, colon);
+  if (host.find_first_of("[]") != std::string_view::npos ||
+      (scheme_end != std::string_view::npos && host.empty())) {
+    return false;
+  }
+  if (colon != std::string_view::npos) {
+    uint32_t port = 0;
+    for (auto c : authority.substr(colon + 1)) {
+      if (c < '0' || c > '9' ||
+          (port = port * 10 + static_cast<uint32_t>(c - '0')) > 0xffff) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}  // namespace detail
+
 template <bool Mutable = false>
 class basic_uri_authority {
  public:
@@ -18,19 +111,19 @@ class basic_uri_authority {
       std::conditional_t<Mutable, std::string, std::string_view>;
 
   /// Empty constructor
-  basic_uri_authority() = default;
+  constexpr basic_uri_authority() = default;
 
   /// Host constructor
-  basic_uri_authority(std::string_view hostname, uint16_t port) : hostname_{hostname}, port_{port} {}
+  constexpr basic_uri_authority(std::string_view hostname, uint16_t port) : hostname_{hostname}, port_{port} {}
 
   /// Userinfo constructor
-  basic_uri_authority(std::string_view username, std::string_view password, std::string_view hostname, uint16_t port = 0)
+  constexpr basic_uri_authority(std::string_view username, std::string_view password, std::string_view hostname, uint16_t port = 0)
       : username_{username}, password_{password}, hostname_{hostname}, port_{port} {}
 
   /// Parsing constructor
-  basic_uri_authority(std::string_view buffer) { parse(buffer); }
+  constexpr basic_uri_authority(std::string_view buffer) { parse(buffer); }
 
-  void parse(std::string_view buffer) {
+  constexpr void parse(std::string_view buffer) {
     auto split_by = [](std::string_view str, char delimiter) {
       auto pos = str.find(delimiter);
       if (pos != std::string_view::npos) {
@@ -51,8 +144,7 @@ class basic_uri_authority {
     auto [host, port_str] = split_by(buffer, ':');
     hostname_ = host;
     if (!port_str.empty()) {
-      auto [result, _] = detail::to_arithmetic<uint16_t>(port_str);
-      port_ = result;
+      port_ = detail::to_port(port_str);
     }
   }
 
@@ -63,10 +155,10 @@ class basic_uri_authority {
     return std::format("{}{}{}", userinfo, hostname_, port_str);
   }
 
-  auto username() const noexcept { return username_; }
-  auto password() const noexcept { return password_; }
-  auto hostname() const noexcept { return hostname_; }
-  auto port() const noexcept { return port_; }
+  constexpr auto username() const noexcept { return username_; }
+  constexpr auto password() const noexcept { return password_; }
+  constexpr auto hostname() const noexcept { return hostname_; }
+  constexpr auto port() const noexcept { return port_; }
 
   void username(std::string_view v) noexcept
     requires(Mutable)
@@ -96,7 +188,267 @@ class basic_uri_authority {
   uint16_t port_ = 0;
 };
 
-/// Parses a URI with minimal memory allocations.
+/// Lazy view of a query string ("a=1&b=2" without the '?'). Parameters are
+/// split on demand while iterating, in order and with duplicates kept;
+/// nothing is decoded or allocated until asked for. Empty segments such as
+/// in "a=1&&b=2" are skipped.
+class query_view {
+ public:
+  /// One `key=value` pair as it appears in the query, still percent-encoded.
+  /// A segment without '=' has an empty value.
+  struct param {
+    std::string_view key;
+    std::string_view value;
+
+    std::string decoded_key() const { return uri_decode(key); }
+    std::string decoded_value() const { return uri_decode(value); }
+  };
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = param;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const param*;
+    using reference = const param&;
+
+    iterator() = default;
+
+    reference operator*() const noexcept { return current_; }
+    pointer operator->() const noexcept { return &current_; }
+
+    iterator& operator++() noexcept {
+      next();
+      return *this;
+    }
+    iterator operator++(int) noexcept {
+      auto copy = *this;
+      next();
+      return copy;
+    }
+
+    friend bool operator==(const iterator& lhs,
+                           const iterator& rhs) noexcept {
+      return lhs.position_ == rhs.position_;
+    }
+
+   private:
+    friend class query_view;
+
+    explicit iterator(std::string_view rest) noexcept : rest_{rest} { next(); }
+
+    void next() noexcept {
+      // Until the next non-empty segment, position_ is null at the end
+      position_ = nullptr;
+      while (!rest_.empty()) {
+        auto end = rest_.find('&');
+        auto segment = rest_.substr(0, end);
+        rest_.remove_prefix(end == std::string_view::npos ? rest_.size()
+                                                          : end + 1);
+        if (segment.empty()) {
+          continue;
+        }
+        auto equals = segment.find('=');
+        current_.key = segment.substr(0, equals);
+        current_.value = equals == std::string_view::npos
+                             ? std::string_view{}
+                             : segment.substr(equals + 1);
+        position_ = segment.data();
+        return;
+      }
+    }
+
+    std::string_view rest_;
+    param current_{};
+    const char* position_{};
+  };
+
+  constexpr query_view() noexcept = default;
+  constexpr explicit query_view(std::string_view raw) noexcept : raw_{raw} {}
+
+  iterator begin() const noexcept { return iterator{raw_}; }
+  iterator end() const noexcept { return {}; }
+
+  /// The query string as it appears in the URI
+  constexpr std::string_view raw() const noexcept { return raw_; }
+  constexpr bool empty() const noexcept { return raw_.empty(); }
+
+  /// First parameter whose decoded key equals `key`, or end()
+  iterator find(std::string_view key) const noexcept {
+    auto it = begin();
+    while (it != end() && !detail::decoded_equals(it->key, key)) {
+      ++it;
+    }
+    return it;
+  }
+
+  /// Raw value of the first parameter named `key`
+  std::optional<std::string_view> get(std::string_view key) const noexcept {
+    if (auto it = find(key); it != end()) {
+      return it->value;
+    }
+    return std::nullopt;
+  }
+
+  bool contains(std::string_view key) const noexcept {
+    return find(key) != end();
+  }
+
+  /// Number of parameters named `key`
+  size_t count(std::string_view key) const noexcept {
+    size_t result{};
+    for (const auto& item : *this) {
+      result += detail::decoded_equals(item.key, key) ? 1 : 0;
+    }
+    return result;
+  }
+
+ private:
+  std::string_view raw_;
+};
+
+template <bool Mutable>
+class basic_uri;
+
+/// A URI in the normal form of RFC 3986 6.2.2 and 6.2.3, built by
+/// basic_uri::normalize(), for use as a cache or routing key. Equivalent
+/// URIs give the same str() and hash(); the hash is FNV-1a of str(),
+/// computed while the string is built.
+class normalized_uri {
+ public:
+  normalized_uri() = default;
+
+  std::string_view str() const noexcept { return buffer_; }
+  uint64_t hash() const noexcept { return hash_; }
+  /// Parsed view of str(), valid as long as this object
+  basic_uri<false> view() const noexcept;
+
+  friend bool operator==(const normalized_uri& lhs,
+                         const normalized_uri& rhs) noexcept {
+    return lhs.hash_ == rhs.hash_ && lhs.buffer_ == rhs.buffer_;
+  }
+
+ private:
+  template <bool>
+  friend class basic_uri;
+
+  static constexpr uint64_t fnv_offset = 14695981039346656037ull;
+  static constexpr uint64_t fnv_prime = 1099511628211ull;
+
+  normalized_uri(std::string_view scheme, std::string_view username,
+                 std::string_view password, std::string_view hostname,
+                 uint16_t port, std::string_view path, std::string_view query,
+                 std::string_view fragment) {
+    buffer_.reserve(scheme.size() + username.size() + password.size() +
+                    hostname.size() + path.size() + query.size() +
+                    fragment.size() + 16);
+
+    if (!scheme.empty()) {
+      for (auto c : scheme) {
+        buffer_.push_back(detail::to_lower(c));
+      }
+      buffer_.append("://");
+    }
+    if (!username.empty()) {
+      detail::normalize_escapes(username, buffer_);
+      if (!password.empty()) {
+        buffer_.push_back(':');
+        detail::normalize_escapes(password, buffer_);
+      }
+      buffer_.push_back('@');
+    }
+    detail::normalize_escapes(hostname, buffer_, true);
+    if (port != 0 && port != default_port(scheme)) {
+      char digits[8];
+      auto [end, _] = std::to_chars(digits, digits + sizeof(digits), port);
+      buffer_.push_back(':');
+      buffer_.append(digits, end);
+    }
+    seal();
+
+    append_path(path, !scheme.empty() || !hostname.empty());
+    seal();
+
+    if (!query.empty()) {
+      buffer_.push_back('?');
+      detail::normalize_escapes(query, buffer_);
+    }
+    if (!fragment.empty()) {
+      buffer_.push_back('#');
+      detail::normalize_escapes(fragment, buffer_);
+    }
+    seal();
+  }
+
+  static uint16_t default_port(std::string_view scheme) noexcept {
+    if (detail::iequals(scheme, "http") || detail::iequals(scheme, "ws")) {
+      return 80;
+    } else if (detail::iequals(scheme, "https") ||
+               detail::iequals(scheme, "wss")) {
+      return 443;
+    }
+    return 0;
+  }
+
+  /// Appends `path` segment by segment with escapes normalized, dropping
+  /// "." and ".." segments once written (RFC 3986 5.2.4), so an escaped
+  /// dot such as "%2E" counts as well. An empty path becomes "/" when
+  /// there is an authority.
+  void append_path(std::string_view path, bool has_authority) {
+    const auto root = buffer_.size();
+    if (path.empty()) {
+      if (has_authority) {
+        buffer_.push_back('/');
+      }
+      return;
+    }
+    if (path.front() != '/') {
+      // Relative path, kept as it is apart from escapes
+      detail::normalize_escapes(path, buffer_);
+      return;
+    }
+
+    while (!path.empty()) {
+      path.remove_prefix(1);
+      auto slash = path.find('/');
+      auto segment = path.substr(0, slash);
+      path.remove_prefix(segment.size());
+      const bool last = path.empty();
+
+      auto mark = buffer_.size();
+      buffer_.push_back('/');
+      detail::normalize_escapes(segment, buffer_);
+      auto written = std::string_view{buffer_}.substr(mark + 1);
+      if (written == "." || written == "..") {
+        const bool up = written.size() == 2;
+        buffer_.resize(mark);
+        if (up) {
+          auto parent = std::string_view{buffer_}.substr(root).rfind('/');
+          buffer_.resize(parent == std::string_view::npos ? root
+                                                          : root + parent);
+        }
+        if (last) {
+          buffer_.push_back('/');
+        }
+      }
+    }
+  }
+
+  /// Folds the bytes appended since the last call into the hash; parts of
+  /// the buffer are sealed only once they can no longer change.
+  void seal() noexcept {
+    for (; hashed_ < buffer_.size(); ++hashed_) {
+      hash_ = (hash_ ^ static_cast<uint8_t>(buffer_[hashed_])) * fnv_prime;
+    }
+  }
+
+  std::string buffer_;
+  uint64_t hash_ = fnv_offset;
+  size_t hashed_{};
+};
+
+/// Parses a URI without allocating anything for uri_view; the query is
+/// kept raw and split lazily by query().
 /// Example: scheme://hostname:port/path?query=value#fragment
 template <bool Mutable = false>
 class basic_uri {
@@ -104,22 +456,26 @@ class basic_uri {
   using underlying_t =
       std::conditional_t<Mutable, std::string, std::string_view>;
 
-  basic_uri() : scheme_{}, authority_{}, path_{}, query_{}, fragment_{} {}
-  basic_uri(std::string_view buffer) : basic_uri{} { parse(buffer); }
+  constexpr basic_uri()
+      : scheme_{}, authority_{}, path_{}, query_{}, fragment_{} {}
+  constexpr basic_uri(std::string_view buffer) : basic_uri{} { parse(buffer); }
 
-  basic_uri& operator=(std::string_view buffer) {
+  constexpr basic_uri& operator=(std::string_view buffer) {
     parse(buffer);
     return *this;
   }
 
-  void parse(std::string_view buffer) {
+  /// Splits `buffer` into its components; constexpr, so a uri_view of a
+  /// literal can be split at compile time (see literals::operator""_uri).
+  constexpr void parse(std::string_view buffer) {
     auto scheme_end = buffer.find("://");
     if (scheme_end != std::string_view::npos) {
       scheme_ = buffer.substr(0, scheme_end);
       buffer.remove_prefix(scheme_end + 3);
     }
 
-    auto path_start = buffer.find('/');
+    // The path, query or fragment ends the authority (RFC 3986 3.2)
+    auto path_start = buffer.find_first_of("/?#");
     authority_ = basic_uri_authority<Mutable>{buffer.substr(0, path_start)};
     if (path_start == std::string_view::npos)
       return;
@@ -136,26 +492,13 @@ class basic_uri {
     if (query_start == std::string_view::npos)
       return;
 
-    auto query_str = buffer.substr(query_start + 1);
-    for (auto part : query_str | std::views::split('&')) {
-      auto [key, value] = detail::split_view<2>(part, "=");
-      query_.emplace(key, value);
-    }
+    query_ = buffer.substr(query_start + 1);
   }
 
   std::string build() const {
     auto scheme_str = scheme_.empty() ? "" : scheme_ + "://";
 
-    std::string query_str;
-    if (!query_.empty()) {
-      query_str = "?";
-      for (const auto& [key, value] : query_) {
-        if (query_str.size() > 1) {
-          query_str.append("&");
-        }
-        query_str += std::format("{}={}", key, value);
-      }
-    }
+    std::string query_str = query_.empty() ? "" : "?" + std::string{query_};
 
     std::string fragment_str = fragment_.empty() ? "" : "#" + fragment_;
 
@@ -163,11 +506,31 @@ class basic_uri {
                        query_str, fragment_str);
   }
 
-  auto scheme() const noexcept { return scheme_; }
-  const auto& authority() const noexcept { return authority_; }
-  auto path() const noexcept { return path_; }
-  const auto& query() const noexcept { return query_; }
-  auto fragment() const noexcept { return fragment_; }
+  /// Normal form for comparing URIs: lower-case scheme and host, no
+  /// default port, no dot segments and canonical percent-encoding
+  normalized_uri normalize() const {
+    return normalized_uri{scheme_,
+                          authority_.username(),
+                          authority_.password(),
+                          authority_.hostname(),
+                          authority_.port(),
+                          path_,
+                          query_,
+                          fragment_};
+  }
+
+  constexpr auto scheme() const noexcept { return scheme_; }
+  constexpr const auto& authority() const noexcept { return authority_; }
+  /// Port of the authority, or the default port of the scheme if omitted
+  constexpr uint16_t port() const noexcept {
+    if (authority_.port() != 0) {
+      return authority_.port();
+    }
+    return detail::iequals(scheme_, "https") ? 443 : 80;
+  }
+  constexpr auto path() const noexcept { return path_; }
+  constexpr query_view query() const noexcept { return query_view{query_}; }
+  constexpr auto fragment() const noexcept { return fragment_; }
 
   void scheme(std::string_view v) noexcept
     requires(Mutable)
@@ -184,10 +547,20 @@ class basic_uri {
   {
     path_ = v;
   }
-  auto& query() noexcept
+  /// Replaces the raw query string, given without the leading '?'
+  void query(std::string_view v) noexcept
+    requires(Mutable)
+  {
+    query_ = v;
+  }
+  /// Appends `key=value` to the query; both have to be encoded already
+  void append_query(std::string_view key, std::string_view value)
     requires(Mutable)
   {
-    return query_;
+    if (!query_.empty()) {
+      query_.push_back('&');
+    }
+    query_.append(key).append("=").append(value);
   }
   void fragment(std::string_view v) noexcept
     requires(Mutable)
@@ -199,12 +572,42 @@ class basic_uri {
   underlying_t scheme_;
   basic_uri_authority<Mutable> authority_;
   underlying_t path_;
-  std::unordered_map<underlying_t, underlying_t> query_;
+  underlying_t query_;
   underlying_t fragment_;
 };
 
 using uri_view = basic_uri<>;
 using uri = basic_uri<true>;
+
+inline uri_view normalized_uri::view() const noexcept {
+  return uri_view{buffer_};
+}
+
+namespace detail {
+// Not constexpr on purpose: reaching it while evaluating a literal makes
+// the literal ill-formed, with this name in the compiler's message.
+inline void malformed_uri_literal() noexcept {}
+}  // namespace detail
+
+namespace literals {
+/// URI split at compile time, e.g. `"https://example.com/a?b=c"_uri`; a
+/// literal that valid_uri() rejects does not compile. The components view
+/// the literal itself, so nothing is parsed or allocated at run time.
+consteval uri_view operator""_uri(const char* str, size_t size) {
+  std::string_view buffer{str, size};
+  if (!detail::valid_uri(buffer)) {
+    detail::malformed_uri_literal();
+  }
+  return uri_view{buffer};
+}
+}  // namespace literals
 }  // namespace baklaga::http
 
+template <>
+struct std::hash<baklaga::http::normalized_uri> {
+  size_t operator()(const baklaga::http::normalized_uri& u) const noexcept {
+    return static_cast<size_t>(u.hash());
+  }
+};
+
 #endif  // BAKLAGA_HTTP_URI_HPP
@@ -0,0 +1,337 @@
+#ifndef BAKLAGA_HTTP_URI_BATCH_HPP
+#define BAKLAGA_HTTP_URI_BATCH_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include "baklaga/http/detail/scan.hpp"
+#include "baklaga/http/uri.hpp"
+
+namespace baklaga::http {
+/// Splits a block of newline-separated URIs (e.g. request targets taken
+/// from an access log) into columns: for every part of every row an
+/// offset from the start of the row and a length, plus the numeric port.
+/// No object is built per row: the block is classified 64 bytes at a time
+/// into delimiter bitmaps with SIMD and rows are split from those. Rows
+/// view the parsed blocks, which have to outlive the batch.
+///
+/// Rows are split like basic_uri::parse(), except that a scheme is only
+/// recognized in front of the first '/', '?' or '#'. Empty lines are
+/// skipped and a trailing '\r' is dropped.
+class uri_batch {
+ public:
+  enum class part : uint8_t {
+    scheme,
+    userinfo,
+    host,
+    port,
+    path,
+    query,
+    fragment,
+  };
+  static constexpr size_t part_count = 7;
+
+  /// Parses every line of `block` and appends one row per non-empty line.
+  /// Returns the number of rows added.
+  size_t parse(std::string_view block) {
+    const auto rows = size();
+    delimiters_t delimiters{block};
+    for (size_t position = 0; position < block.size();) {
+      position = add_row(block, position, delimiters);
+    }
+    return size() - rows;
+  }
+
+  /// Drops all rows, keeping the storage for the next block
+  void clear() noexcept { size_ = 0; }
+
+  /// Makes room for `rows` rows in total
+  void reserve(size_t rows) {
+    if (rows > lines_.size()) {
+      lines_.resize(rows);
+      line_sizes_.resize(rows);
+      for (auto& column : columns_) {
+        column.offsets.resize(rows);
+        column.sizes.resize(rows);
+      }
+      ports_.resize(rows);
+    }
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// The whole row as it appears in its block
+  std::string_view line(size_t row) const noexcept {
+    return {lines_[row], line_sizes_[row]};
+  }
+
+  /// `p` of `row`, empty if the row has none
+  std::string_view get(size_t row, part p) const noexcept {
+    const auto& column = columns_[static_cast<size_t>(p)];
+    return {lines_[row] + column.offsets[row], column.sizes[row]};
+  }
+
+  /// Numeric port of `row`, 0 if the row has none or it is malformed
+  uint16_t port(size_t row) const noexcept { return ports_[row]; }
+
+  /// Column access: offsets from the start of each row and lengths of `p`
+  std::span<const uint32_t> offsets(part p) const noexcept {
+    return {columns_[static_cast<size_t>(p)].offsets.data(), size_};
+  }
+  std::span<const uint32_t> sizes(part p) const noexcept {
+    return {columns_[static_cast<size_t>(p)].sizes.data(), size_};
+  }
+  std::span<const uint16_t> ports() const noexcept {
+    return {ports_.data(), size_};
+  }
+
+ private:
+  struct column_t {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> sizes;
+  };
+
+  /// Forward-only cursor over the delimiters of a block. Every 64-byte
+  /// window is classified into one bitmap per delimiter once, when the
+  /// cursor reaches it, so finding the next delimiter of a row is a few
+  /// bit operations instead of another pass over its bytes.
+  class delimiters_t {
+   public:
+    enum : unsigned {
+      colon = 1 << 0,
+      slash = 1 << 1,
+      question = 1 << 2,
+      hash = 1 << 3,
+      at = 1 << 4,
+      lf = 1 << 5,
+    };
+
+    explicit delimiters_t(std::string_view block) noexcept
+        : block_{block},
+          classify_{detail::classifier<':', '/', '?', '#', '@', '\n'>()} {
+      load(0);
+    }
+
+    /// Moves to `position`, which must not be behind the cursor.
+    void seek(size_t position) noexcept {
+      if (position / 64 != window_) {
+        load(position / 64);
+      }
+      live_ = ~uint64_t{0} << (position % 64);
+    }
+
+    /// Position of the first delimiter of `Set` at or after the cursor,
+    /// block size if there is none; the cursor moves up to it.
+    template <unsigned Set>
+    size_t find() noexcept {
+      for (;;) {
+        if (auto mask = select<Set>() & live_) {
+          live_ &= ~uint64_t{0} << std::countr_zero(mask);
+          return std::min(window_ * 64 + std::countr_zero(mask),
+                          block_.size());
+        }
+        if ((window_ + 1) * 64 >= block_.size()) {
+          return block_.size();
+        }
+        load(window_ + 1);
+      }
+    }
+
+   private:
+    static constexpr size_t kinds = 6;
+
+    template <unsigned Set>
+    uint64_t select() const noexcept {
+      return [this]<size_t... K>(std::index_sequence<K...>) {
+        return ((Set & (1u << K) ? masks_[K] : uint64_t{0}) | ...);
+      }(std::make_index_sequence<kinds>{});
+    }
+
+    void load(size_t window) noexcept {
+      window_ = window;
+      live_ = ~uint64_t{0};
+      auto offset = window * 64;
+      if (offset >= block_.size()) {
+        masks_.fill(0);
+      } else if (block_.size() - offset >= 64) {
+        classify_(block_.data() + offset, masks_.data());
+      } else {
+        // Zero bytes match no delimiter
+        char tail[64]{};
+        std::memcpy(tail, block_.data() + offset, block_.size() - offset);
+        classify_(tail, masks_.data());
+      }
+    }
+
+    std::string_view block_;
+    detail::classify_fn_t classify_;
+    std::array<uint64_t, kinds> masks_;
+    size_t window_{};
+    uint64_t live_{};
+  };
+
+  /// Adds the row starting at the cursor position `begin` unless it is
+  /// empty, returns the start of the next one.
+  size_t add_row(std::string_view block, size_t begin,
+                 delimiters_t& delimiters) {
+    using d = delimiters_t;
+    constexpr auto authority_end = d::slash | d::question | d::hash | d::lf;
+    std::array<std::pair<size_t, size_t>, part_count> parts;
+    parts.fill({SIZE_MAX, SIZE_MAX});
+    auto is = [&](size_t position, char c) {
+      return position < block.size() && block[position] == c;
+    };
+
+    auto it = delimiters.find<d::colon | authority_end>();
+    auto authority = begin;
+    if (it != begin && is(it, ':') && is(it + 1, '/') && is(it + 2, '/')) {
+      parts[size_t(part::scheme)] = {begin, it};
+      authority = it + 3;
+      delimiters.seek(authority);
+    }
+
+    // The first '@' ends the userinfo, the first ':' after it the host
+    auto host = authority;
+    auto colon = SIZE_MAX;
+    for (;;) {
+      it = delimiters.find<d::colon | d::at | authority_end>();
+      if (it == block.size() || (block[it] != ':' && block[it] != '@')) {
+        break;
+      }
+      if (block[it] == ':') {
+        colon = std::min(colon, it);
+      } else if (host == authority) {
+        parts[size_t(part::userinfo)] = {authority, it};
+        host = it + 1;
+        colon = SIZE_MAX;
+      }
+      delimiters.seek(it + 1);
+    }
+    auto path = it;
+    parts[size_t(part::host)] = {host, std::min(colon, path)};
+    if (colon != SIZE_MAX) {
+      parts[size_t(part::port)] = {colon + 1, path};
+    }
+
+    it = delimiters.find<d::question | d::hash | d::lf>();
+    parts[size_t(part::path)] = {path, it};
+    if (is(it, '?')) {
+      auto query = it + 1;
+      delimiters.seek(query);
+      it = delimiters.find<d::hash | d::lf>();
+      parts[size_t(part::query)] = {query, it};
+    }
+    if (is(it, '#')) {
+      auto fragment = it + 1;
+      delimiters.seek(fragment);
+      it = delimiters.find<d::lf>();
+      parts[size_t(part::fragment)] = {fragment, it};
+    }
+
+    auto next = it == block.size() ? it : it + 1;
+    delimiters.seek(next);
+    auto end = it != begin && block[it - 1] == '\r' ? it - 1 : it;
+    if (end == begin) {
+      return next;
+    }
+
+    // Columns grow for many rows at once, a row is written with plain
+    // stores rather than a push_back per column
+    if (size_ == lines_.size()) {
+      reserve(std::max<size_t>(size_ * 2, 1024));
+    }
+    const auto row = size_++;
+    auto store = [&](size_t i) {
+      auto [first, second] = parts[i];
+      if (first == SIZE_MAX) {
+        // Absent parts are empty and sit where they would start
+        first = second = i < size_t(part::path) ? begin : end;
+      }
+      second = std::min(second, end);
+      first = std::min(first, second);
+      columns_[i].offsets[row] = static_cast<uint32_t>(first - begin);
+      columns_[i].sizes[row] = static_cast<uint32_t>(second - first);
+    };
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (store(I), ...);
+    }(std::make_index_sequence<part_count>{});
+    ports_[row] = detail::to_port(
+        {block.data() + begin + columns_[size_t(part::port)].offsets[row],
+         columns_[size_t(part::port)].sizes[row]});
+    lines_[row] = block.data() + begin;
+    line_sizes_[row] = static_cast<uint32_t>(end - begin);
+    return next;
+  }
+
+  std::vector<const char*> lines_;
+  std::vector<uint32_t> line_sizes_;
+  std::array<column_t, part_count> columns_;
+  std::vector<uint16_t> ports_;
+  size_t size_{};
+};
+
+#if defined(__linux__)
+/// Read-only mapping of a whole file, e.g. an access log handed to
+/// uri_batch::parse() without reading it into a buffer first.
+class mapped_file {
+ public:
+  mapped_file(const char* path, std::error_code& ec) noexcept {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      ec = {errno, std::system_category()};
+      return;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ec = {errno, std::system_category()};
+    } else if (info.st_size > 0) {
+      auto size = static_cast<size_t>(info.st_size);
+      auto* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        ec = {errno, std::system_category()};
+      } else {
+        ::madvise(map, size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(map);
+        size_ = size;
+      }
+    }
+    ::close(fd);
+  }
+  mapped_file(mapped_file&& other) noexcept
+      : data_{std::exchange(other.data_, nullptr)},
+        size_{std::exchange(other.size_, 0)} {}
+  mapped_file& operator=(mapped_file&&) = delete;
+  ~mapped_file() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  std::string_view data() const noexcept { return {data_, size_}; }
+
+ private:
+  const char* data_{};
+  size_t size_{};
+};
+#endif  // defined(__linux__)
+}  // namespace baklaga::http
+
+#endif  // BAKLAGA_HTTP_URI_BATCH_HPP
@@ -1,42 +1,356 @@
 #ifndef BAKLAGA_HTTP_URI_ENCODE_HPP
 #define BAKLAGA_HTTP_URI_ENCODE_HPP
 
-#include <format>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 
-#include "baklaga/http/detail/string.hpp"
+#include "baklaga/http/detail/scan.hpp"
 
 namespace baklaga::http {
-inline std::string uri_encode(std::string_view buffer) {
-  std::string result{};
-  result.reserve(buffer.size() * 3);
-  for (auto c : buffer) {
-    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-      result.push_back(c);
-    } else {
-      result.append(std::format("%{:02x}", static_cast<uint8_t>(c)));
+namespace detail {
+/// Per-byte classification for percent-encoding: unreserved characters
+/// (RFC 3986 2.3) are kept as is, everything else is escaped.
+inline constexpr auto unreserved_table = [] {
+  std::array<bool, 256> table{};
+  for (int c = 0; c < 256; ++c) {
+    table[c] = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+               (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' ||
+               c == '~';
+  }
+  return table;
+}();
+
+/// Value of a hex digit, 0xff for any other byte.
+inline constexpr auto hex_value_table = [] {
+  std::array<uint8_t, 256> table{};
+  for (int c = 0; c < 256; ++c) {
+    table[c] = c >= '0' && c <= '9'   ? static_cast<uint8_t>(c - '0')
+               : c >= 'a' && c <= 'f' ? static_cast<uint8_t>(c - 'a' + 10)
+               : c >= 'A' && c <= 'F' ? static_cast<uint8_t>(c - 'A' + 10)
+                                      : uint8_t{0xff};
+  }
+  return table;
+}();
+
+[[nodiscard]] constexpr bool is_unreserved(char c) noexcept {
+  return unreserved_table[static_cast<uint8_t>(c)];
+}
+
+/// Returns a pointer to the first byte in [first, last) that has to be
+/// escaped, or last if there is none.
+using span_fn_t = const char* (*)(const char* first, const char* last) noexcept;
+
+inline const char* skip_unreserved_scalar(const char* first,
+                                          const char* last) noexcept {
+  while (first != last && is_unreserved(*first)) {
+    ++first;
+  }
+  return first;
+}
+
+#ifdef BAKLAGA_HTTP_SIMD_X86
+// Bytes are compared as signed, so everything from 0x80 up is negative and
+// falls outside of all ranges below. Setting bit 0x20 folds upper case
+// letters onto lower case without bringing any other byte into 'a'..'z'.
+inline const char* skip_unreserved_sse2(const char* first,
+                                        const char* last) noexcept {
+  const auto case_bit = _mm_set1_epi8(0x20);
+  const auto below_lower = _mm_set1_epi8('a' - 1);
+  const auto above_lower = _mm_set1_epi8('z' + 1);
+  const auto below_digit = _mm_set1_epi8('0' - 1);
+  const auto above_digit = _mm_set1_epi8('9' + 1);
+  const auto below_mark = _mm_set1_epi8('-' - 1);
+  const auto above_mark = _mm_set1_epi8('.' + 1);
+  const auto underscore = _mm_set1_epi8('_');
+  const auto tilde = _mm_set1_epi8('~');
+  for (; last - first >= 16; first += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    auto folded = _mm_or_si128(block, case_bit);
+    auto letter = _mm_and_si128(_mm_cmpgt_epi8(folded, below_lower),
+                                _mm_cmplt_epi8(folded, above_lower));
+    auto digit = _mm_and_si128(_mm_cmpgt_epi8(block, below_digit),
+                               _mm_cmplt_epi8(block, above_digit));
+    // '-' and '.' are adjacent
+    auto mark = _mm_and_si128(_mm_cmpgt_epi8(block, below_mark),
+                              _mm_cmplt_epi8(block, above_mark));
+    auto other = _mm_or_si128(_mm_cmpeq_epi8(block, underscore),
+                              _mm_cmpeq_epi8(block, tilde));
+    auto keep = _mm_or_si128(_mm_or_si128(letter, digit),
+                             _mm_or_si128(mark, other));
+    if (auto mask = ~static_cast<uint32_t>(_mm_movemask_epi8(keep)) & 0xffff) {
+      return first + std::countr_zero(mask);
     }
   }
-  return result;
+  return skip_unreserved_scalar(first, last);
 }
 
-inline std::string uri_decode(std::string_view buffer) {
-  std::string result{};
-  result.reserve(buffer.size());
-  for (size_t i = 0; i < buffer.size(); ++i) {
-    if (buffer[i] == '%' && i + 2 < buffer.size()) {
-      auto hex = buffer.substr(i + 1, 2);
-      auto [c, _] = detail::to_arithmetic<uint8_t>(hex, 16);
-      result.push_back(c);
-      i += 2;
+BAKLAGA_HTTP_TARGET_AVX2 inline const char* skip_unreserved_avx2(
+    const char* first, const char* last) noexcept {
+  const auto case_bit = _mm256_set1_epi8(0x20);
+  const auto below_lower = _mm256_set1_epi8('a' - 1);
+  const auto above_lower = _mm256_set1_epi8('z' + 1);
+  const auto below_digit = _mm256_set1_epi8('0' - 1);
+  const auto above_digit = _mm256_set1_epi8('9' + 1);
+  const auto below_mark = _mm256_set1_epi8('-' - 1);
+  const auto above_mark = _mm256_set1_epi8('.' + 1);
+  const auto underscore = _mm256_set1_epi8('_');
+  const auto tilde = _mm256_set1_epi8('~');
+  for (; last - first >= 32; first += 32) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    auto folded = _mm256_or_si256(block, case_bit);
+    auto letter = _mm256_and_si256(_mm256_cmpgt_epi8(folded, below_lower),
+                                   _mm256_cmpgt_epi8(above_lower, folded));
+    auto digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, below_digit),
+                                  _mm256_cmpgt_epi8(above_digit, block));
+    auto mark = _mm256_and_si256(_mm256_cmpgt_epi8(block, below_mark),
+                                 _mm256_cmpgt_epi8(above_mark, block));
+    auto other = _mm256_or_si256(_mm256_cmpeq_epi8(block, underscore),
+                                 _mm256_cmpeq_epi8(block, tilde));
+    auto keep = _mm256_or_si256(_mm256_or_si256(letter, digit),
+                                _mm256_or_si256(mark, other));
+    if (auto mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(keep))) {
+      return first + std::countr_zero(mask);
+    }
+  }
+  return skip_unreserved_sse2(first, last);
+}
+#endif
+
+/// Picks the widest kernel supported by the running CPU.
+inline span_fn_t skip_unreserved() noexcept {
+  static const span_fn_t instance = [] {
+#ifdef BAKLAGA_HTTP_SIMD_X86
+    return has_avx2() ? skip_unreserved_avx2 : skip_unreserved_sse2;
+#else
+    return skip_unreserved_scalar;
+#endif
+  }();
+  return instance;
+}
+
+/// Encodes [first, last) into `out`, which must hold encoded_size() bytes.
+inline char* encode_to(const char* first, const char* last,
+                       char* out) noexcept {
+  constexpr std::string_view digits = "0123456789abcdef";
+  const auto skip = skip_unreserved();
+  while (first != last) {
+    auto run = skip(first, last);
+    std::memcpy(out, first, static_cast<size_t>(run - first));
+    out += run - first;
+    first = run;
+    // Escapes tend to come in groups (UTF-8 sequences, separators)
+    while (first != last && !is_unreserved(*first)) {
+      auto c = static_cast<uint8_t>(*first++);
+      out[0] = '%';
+      out[1] = digits[c >> 4];
+      out[2] = digits[c & 0xf];
+      out += 3;
+    }
+  }
+  return out;
+}
+
+/// Decodes [first, last) into `out`, which may be `first` itself: the
+/// output never gets ahead of the input. A '%' that does not start a valid
+/// escape fails with invalid_argument if `strict` is set and is copied
+/// literally otherwise.
+inline char* decode_to(const char* first, const char* last, char* out,
+                       bool strict, std::error_code& ec) noexcept {
+  while (first != last) {
+    auto* escape = static_cast<const char*>(
+        std::memchr(first, '%', static_cast<size_t>(last - first)));
+    if (escape == nullptr) {
+      escape = last;
+    }
+    if (out != first) {
+      std::memmove(out, first, static_cast<size_t>(escape - first));
+    }
+    out += escape - first;
+    first = escape;
+    if (first == last) {
+      break;
+    }
+
+    uint8_t high = 0xff;
+    uint8_t low = 0xff;
+    if (last - first >= 3) {
+      high = hex_value_table[static_cast<uint8_t>(first[1])];
+      low = hex_value_table[static_cast<uint8_t>(first[2])];
+    }
+    if ((high | low) > 0xf) {
+      if (strict) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        return out;
+      }
+      *out++ = *first++;
+      continue;
+    }
+    *out++ = static_cast<char>((high << 4) | low);
+    first += 3;
+  }
+  return out;
+}
+
+/// Compares percent-encoded `encoded` with plain `decoded` without
+/// decoding into a buffer; malformed escapes compare literally.
+[[nodiscard]] constexpr bool decoded_equals(std::string_view encoded,
+                                            std::string_view decoded) noexcept {
+  size_t i = 0;
+  for (auto c : decoded) {
+    if (i == encoded.size()) {
+      return false;
+    }
+    if (encoded[i] == '%' && encoded.size() - i >= 3) {
+      auto high = hex_value_table[static_cast<uint8_t>(encoded[i + 1])];
+      auto low = hex_value_table[static_cast<uint8_t>(encoded[i + 2])];
+      if ((high | low) <= 0xf) {
+        if (static_cast<uint8_t>(c) != ((high << 4) | low)) {
+          return false;
+        }
+        i += 3;
+        continue;
+      }
+    }
+    if (encoded[i++] != c) {
+      return false;
+    }
+  }
+  return i == encoded.size();
+}
+
+/// Appends `input` to `out` with percent-encoding normalized (RFC 3986
+/// 6.2.2.1, 6.2.2.2): escaped unreserved characters are decoded and the hex
+/// digits of other escapes are upper-cased. Everything else is copied,
+/// lower-cased if `lower` is set; malformed escapes are kept as they are.
+inline void normalize_escapes(std::string_view input, std::string& out,
+                              bool lower = false) {
+  constexpr std::string_view digits = "0123456789ABCDEF";
+  while (!input.empty()) {
+    auto escape = lower ? size_t{0} : input.find('%');
+    if (escape == std::string_view::npos) {
+      out.append(input);
+      return;
+    }
+    out.append(input.substr(0, escape));
+    input.remove_prefix(escape);
+
+    auto c = input.front();
+    if (c != '%' || input.size() < 3 ||
+        (hex_value_table[static_cast<uint8_t>(input[1])] |
+         hex_value_table[static_cast<uint8_t>(input[2])]) > 0xf) {
+      out.push_back(lower ? to_lower(c) : c);
+      input.remove_prefix(1);
+      continue;
+    }
+    auto value = static_cast<uint8_t>(
+        (hex_value_table[static_cast<uint8_t>(input[1])] << 4) |
+        hex_value_table[static_cast<uint8_t>(input[2])]);
+    if (is_unreserved(static_cast<char>(value))) {
+      auto decoded = static_cast<char>(value);
+      out.push_back(lower ? to_lower(decoded) : decoded);
     } else {
-      result.push_back(buffer[i]);
+      out.push_back('%');
+      out.push_back(digits[value >> 4]);
+      out.push_back(digits[value & 0xf]);
     }
+    input.remove_prefix(3);
   }
+}
+}  // namespace detail
+
+/// Exact length of uri_encode(buffer).
+[[nodiscard]] inline size_t encoded_size(std::string_view buffer) noexcept {
+  const auto skip = detail::skip_unreserved();
+  const char* first = buffer.data();
+  const char* last = first + buffer.size();
+  size_t size = buffer.size();
+  while ((first = skip(first, last)) != last) {
+    for (; first != last && !detail::is_unreserved(*first); ++first) {
+      size += 2;
+    }
+  }
+  return size;
+}
 
+/// Percent-encodes every byte outside of the unreserved set.
+inline std::string uri_encode(std::string_view buffer) {
+  std::string result(encoded_size(buffer), '\0');
+  detail::encode_to(buffer.data(), buffer.data() + buffer.size(),
+                    result.data());
   return result;
 }
+
+/// Encodes into caller storage and returns the number of bytes written.
+/// Fails with no_buffer_space, writing nothing, if `output` is shorter
+/// than encoded_size(buffer).
+inline size_t uri_encode(std::string_view buffer, std::span<char> output,
+                         std::error_code& ec) noexcept {
+  auto size = encoded_size(buffer);
+  if (size > output.size()) {
+    ec = std::make_error_code(std::errc::no_buffer_space);
+    return 0;
+  }
+  detail::encode_to(buffer.data(), buffer.data() + buffer.size(),
+                    output.data());
+  return size;
+}
+
+/// Decodes percent-encoded bytes; a '%' not followed by two hex digits is
+/// kept as is.
+inline std::string uri_decode(std::string_view buffer) {
+  std::string result(buffer.size(), '\0');
+  std::error_code ec;
+  auto* end = detail::decode_to(buffer.data(), buffer.data() + buffer.size(),
+                                result.data(), false, ec);
+  result.resize(static_cast<size_t>(end - result.data()));
+  return result;
+}
+
+/// Decodes percent-encoded bytes, failing with invalid_argument on a '%'
+/// not followed by two hex digits.
+inline std::string uri_decode(std::string_view buffer, std::error_code& ec) {
+  std::string result(buffer.size(), '\0');
+  auto* end = detail::decode_to(buffer.data(), buffer.data() + buffer.size(),
+                                result.data(), true, ec);
+  result.resize(ec ? 0 : static_cast<size_t>(end - result.data()));
+  return result;
+}
+
+/// Decodes into caller storage and returns the number of bytes written,
+/// never more than buffer.size(). Fails with invalid_argument on a
+/// malformed escape and with no_buffer_space if `output` may be too short.
+inline size_t uri_decode(std::string_view buffer, std::span<char> output,
+                         std::error_code& ec) noexcept {
+  if (buffer.size() > output.size()) {
+    ec = std::make_error_code(std::errc::no_buffer_space);
+    return 0;
+  }
+  auto* end = detail::decode_to(buffer.data(), buffer.data() + buffer.size(),
+                                output.data(), true, ec);
+  return ec ? 0 : static_cast<size_t>(end - output.data());
+}
+
+/// Decodes `buffer` in place and returns the decoded length; the bytes
+/// after it are left unspecified. Fails with invalid_argument on a
+/// malformed escape.
+inline size_t uri_decode_in_place(std::span<char> buffer,
+                                  std::error_code& ec) noexcept {
+  auto* end = detail::decode_to(buffer.data(), buffer.data() + buffer.size(),
+                                buffer.data(), true, ec);
+  return ec ? 0 : static_cast<size_t>(end - buffer.data());
+}
+
+inline void uri_decode_in_place(std::string& buffer, std::error_code& ec) {
+  auto size = uri_decode_in_place(std::span<char>{buffer}, ec);
+  if (!ec) {
+    buffer.resize(size);
+  }
+}
 }  // namespace baklaga::http
 
 #endif  // BAKLAGA_HTTP_URI_ENCODE_HPP
@@ -0,0 +1,1251 @@
+#ifndef BAKLAGA_HTTP_URING_HPP
+#define BAKLAGA_HTTP_URING_HPP
+
+#include "baklaga/http/epoll.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BAKLAGA_HTTP_HAS_URING 1
+#include <linux/io_uring.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "baklaga/http/concept/socket.hpp"
+#include "baklaga/http/task.hpp"
+#include "baklaga/http/timer_wheel.hpp"
+
+namespace baklaga::http {
+/// Target of a submission; the completion queue entry carries its address.
+/// `complete` returns the coroutine to resume, if any.
+struct uring_operation {
+  std::coroutine_handle<> (*complete)(uring_operation&, int32_t res,
+                                      uint32_t flags){};
+};
+
+namespace detail {
+/// Submission and completion rings of one io_uring instance, set up with
+/// raw system calls so no liburing is needed.
+class uring {
+ public:
+  uring() = default;
+  uring(const uring&) = delete;
+  uring& operator=(const uring&) = delete;
+  ~uring() {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+      ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+      ::munmap(sq_ring_, sq_ring_size_);
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  /// Returns false if the kernel does not provide io_uring (or forbids it).
+  bool init(unsigned entries) noexcept {
+    io_uring_params params{};
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+#if defined(IORING_ENTER_EXT_ARG)
+    timed_wait_ = params.features & IORING_FEAT_EXT_ARG;
+#endif
+    sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+    if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes_ == nullptr) {
+      return false;
+    }
+
+    auto* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+
+    auto* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  /// Next free submission entry, zeroed. Flushes the queue when it is full.
+  io_uring_sqe* next_sqe(uint64_t user_data) noexcept {
+    if (tail_ - load(sq_head_) >= sq_entries_) {
+      enter(0);
+    }
+    auto index = tail_ & sq_mask_;
+    auto* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    ++tail_;
+    return sqe;
+  }
+
+  /// Submits queued entries and waits for at least `wait` completions,
+  /// or until `timeout_ms` passed if it is not negative (needs
+  /// timed_wait()).
+  int enter(unsigned wait, int timeout_ms = -1) noexcept {
+    std::atomic_ref<unsigned>{*sq_tail_}.store(tail_,
+                                               std::memory_order_release);
+    auto submit = tail_ - submitted_;
+    if (submit == 0 && wait == 0) {
+      return 0;
+    }
+    unsigned flags = wait != 0 ? IORING_ENTER_GETEVENTS : 0u;
+    const void* arg{};
+    size_t arg_size{};
+#if defined(IORING_ENTER_EXT_ARG)
+    __kernel_timespec timeout{};
+    io_uring_getevents_arg getevents{};
+    if (wait != 0 && timeout_ms >= 0 && timed_wait_) {
+      timeout.tv_sec = timeout_ms / 1000;
+      timeout.tv_nsec = (timeout_ms % 1000) * 1'000'000LL;
+      getevents.ts = reinterpret_cast<uint64_t>(&timeout);
+      flags |= IORING_ENTER_EXT_ARG;
+      arg = &getevents;
+      arg_size = sizeof(getevents);
+    }
+#endif
+    for (;;) {
+      auto result = ::syscall(__NR_io_uring_enter, fd_, submit, wait, flags,
+                              arg, arg_size);
+      if (result >= 0) {
+        submitted_ += static_cast<unsigned>(result);
+        return 0;
+      } else if (errno == ETIME) {
+        // Nothing was submitted and the wait timed out
+        return 0;
+      } else if (errno != EINTR) {
+        return -errno;
+      }
+    }
+  }
+
+  /// Passes every available completion to `fn(user_data, res, flags)`.
+  template <typename Fn>
+  void reap(Fn&& fn) {
+    auto head = *cq_head_;
+    auto tail = load(cq_tail_);
+    for (; head != tail; ++head) {
+      const auto& cqe = cqes_[head & cq_mask_];
+      auto user_data = cqe.user_data;
+      auto res = cqe.res;
+      auto flags = cqe.flags;
+      std::atomic_ref<unsigned>{*cq_head_}.store(head + 1,
+                                                 std::memory_order_release);
+      fn(user_data, res, flags);
+    }
+  }
+
+  int register_resource(unsigned opcode, const void* arg,
+                        unsigned count) noexcept {
+    auto result =
+        ::syscall(__NR_io_uring_register, fd_, opcode, arg, count);
+    return result < 0 ? -errno : static_cast<int>(result);
+  }
+
+  bool valid() const noexcept { return sqes_ != nullptr; }
+  /// enter() can wait with a timeout (5.11+)
+  bool timed_wait() const noexcept { return timed_wait_; }
+
+ private:
+  static unsigned load(unsigned* value) noexcept {
+    return std::atomic_ref<unsigned>{*value}.load(std::memory_order_acquire);
+  }
+
+  void* map(size_t size, uint64_t offset) noexcept {
+    auto* result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return result == MAP_FAILED ? nullptr : result;
+  }
+
+  int fd_{-1};
+  void* sq_ring_{};
+  void* cq_ring_{};
+  io_uring_sqe* sqes_{};
+  size_t sq_ring_size_{};
+  size_t cq_ring_size_{};
+  size_t sqes_size_{};
+  unsigned* sq_head_{};
+  unsigned* sq_tail_{};
+  unsigned* sq_array_{};
+  unsigned sq_mask_{};
+  unsigned sq_entries_{};
+  unsigned tail_{};
+  unsigned submitted_{};
+  unsigned* cq_head_{};
+  unsigned* cq_tail_{};
+  unsigned cq_mask_{};
+  io_uring_cqe* cqes_{};
+  bool timed_wait_{};
+};
+}  // namespace detail
+
+/// One io_uring instance shared by the sockets of a thread, and the
+/// executor that resumes their coroutines. Sockets are installed into a
+/// fixed file table, memory passed to register_buffers() is read and
+/// written with the *_FIXED operations, and async sockets receive with
+/// multishot recv into provided buffers where the kernel supports it
+/// (6.0+). Check valid(): without io_uring the sockets use plain system
+/// calls.
+class uring_context {
+ public:
+  struct options {
+    unsigned entries = 256;
+    /// Size of the fixed file table, 0 disables it
+    unsigned max_files = 1024;
+    /// Provided buffers for multishot receive (a power of two), 0 disables
+    /// multishot receive
+    unsigned buffer_count = 256;
+    unsigned buffer_size = 4096;
+    /// Share the provided buffers through a registered ring (5.19+). Without
+    /// it, or if the kernel refuses the ring, each buffer is handed back
+    /// with an IORING_OP_PROVIDE_BUFFERS submission instead.
+    bool buffer_ring = true;
+  };
+
+  uring_context() : uring_context(options{}) {}
+  explicit uring_context(options opts) {
+    if (!ring_.init(opts.entries)) {
+      return;
+    }
+    setup_files(opts.max_files);
+    setup_buffers(opts.buffer_count, opts.buffer_size, opts.buffer_ring);
+  }
+  ~uring_context() {
+    if (buffer_ring_ != nullptr) {
+      ::munmap(buffer_ring_, buffer_ring_size_);
+    }
+  }
+
+  uring_context(const uring_context&) = delete;
+  uring_context& operator=(const uring_context&) = delete;
+
+  /// True if the kernel provides io_uring
+  static bool supported() noexcept {
+    detail::uring probe;
+    return probe.init(2);
+  }
+
+  bool valid() const noexcept { return ring_.valid(); }
+  bool fixed_files() const noexcept { return !free_files_.empty(); }
+  bool multishot() const noexcept { return multishot_; }
+
+  /// Registers memory that sockets read into or write from, which then skips
+  /// the per-operation page pinning. Replaces earlier registrations.
+  std::error_code register_buffers(std::span<const iovec> buffers) {
+    if (!registered_.empty()) {
+      ring_.register_resource(IORING_UNREGISTER_BUFFERS, nullptr, 0);
+      registered_.clear();
+    }
+    auto result = ring_.register_resource(
+        IORING_REGISTER_BUFFERS, buffers.data(),
+        static_cast<unsigned>(buffers.size()));
+    if (result < 0) {
+      return {-result, std::system_category()};
+    }
+    registered_.assign(buffers.begin(), buffers.end());
+    return {};
+  }
+
+  /// Index of the registered buffer containing [data, data + size), or -1
+  int registered_index(const void* data, size_t size) const noexcept {
+    auto* begin = static_cast<const char*>(data);
+    for (size_t i = 0; i < registered_.size(); ++i) {
+      auto* base = static_cast<const char*>(registered_[i].iov_base);
+      if (begin >= base && begin + size <= base + registered_[i].iov_len) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  /// Starts `t` on the next iteration of run(), see epoll_executor::spawn().
+  template <typename Ty>
+  void spawn(task<Ty> t) {
+    post(t.detach());
+  }
+  void post(std::coroutine_handle<> handle) { ready_.push_back(handle); }
+
+  /// Runs until no coroutine is ready or waiting for a completion.
+  void run() {
+    while (run_once(true)) {
+    }
+  }
+
+  /// Resumes the ready coroutines, submits the queued operations and
+  /// dispatches completions, waiting for one (or until the next timer is
+  /// due) if `wait` is set, then fires the expired timers. Returns false
+  /// once there is nothing left to do.
+  bool run_once(bool wait) {
+    while (!ready_.empty()) {
+      running_.swap(ready_);
+      for (auto handle : running_) {
+        handle.resume();
+      }
+      running_.clear();
+    }
+    if (waiting_ == 0) {
+      ring_.enter(0);
+      return false;
+    }
+    auto timeout_ms = wait ? timers_.timeout_ms() : -1;
+    if (timeout_ms >= 0 && !ring_.timed_wait()) {
+      // Older kernels: a timeout that also ends with the next completion
+      timeout_spec_.tv_sec = timeout_ms / 1000;
+      timeout_spec_.tv_nsec = (timeout_ms % 1000) * 1'000'000LL;
+      auto* sqe = prepare(timeout_);
+      sqe->opcode = IORING_OP_TIMEOUT;
+      sqe->addr = reinterpret_cast<uint64_t>(&timeout_spec_);
+      sqe->len = 1;
+      sqe->off = 1;
+    }
+    ring_.enter(wait ? 1 : 0, timeout_ms);
+    dispatch();
+    timers_.advance();
+    return true;
+  }
+
+  /// Timers advanced by run_once(), shared by every socket of the context
+  timer_wheel& timers() noexcept { return timers_; }
+
+  /// Queues a submission for `op`; it is sent with the next enter.
+  io_uring_sqe* prepare(uring_operation& op) noexcept {
+    return ring_.next_sqe(reinterpret_cast<uint64_t>(&op));
+  }
+
+  /// Accounts for a coroutine that waits until its operation returns it.
+  void suspended() noexcept { ++waiting_; }
+
+  /// Submits and waits until `done()`, used by the blocking sockets.
+  /// Coroutines completed meanwhile are resumed by the next run_once().
+  template <typename PredTy>
+  void wait_until(PredTy&& done) {
+    while (!done()) {
+      ring_.enter(1);
+      dispatch();
+    }
+  }
+
+  /// Installs `fd` into the fixed file table, returns its slot or -1.
+  int install(int fd) noexcept {
+    if (free_files_.empty()) {
+      return -1;
+    }
+    auto slot = free_files_.back();
+    if (!update_file(slot, fd)) {
+      return -1;
+    }
+    free_files_.pop_back();
+    return slot;
+  }
+  void uninstall(int slot) noexcept {
+    if (slot >= 0 && update_file(slot, -1)) {
+      free_files_.push_back(slot);
+    }
+  }
+
+  /// Points `sqe` at a socket, through the fixed file table if installed.
+  static void target(io_uring_sqe* sqe, int fd, int slot) noexcept {
+    if (slot >= 0) {
+      sqe->fd = slot;
+      sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+      sqe->fd = fd;
+    }
+  }
+
+  /// Provided buffer `id` as filled by a completion of `size` bytes
+  std::span<const uint8_t> provided(uint16_t id, size_t size) const noexcept {
+    return {buffers_.get() + size_t{id} * buffer_size_, size};
+  }
+  /// Accounts for a provided buffer filled by a completion
+  void take() noexcept { ++lent_; }
+  /// Hands a provided buffer back to the kernel.
+  void recycle(uint16_t id) noexcept {
+    --lent_;
+    provide(id);
+  }
+  /// True if sockets hold provided buffers that were not read yet
+  bool buffers_lent() const noexcept { return lent_ != 0; }
+  /// Multishot receive was rejected by the kernel
+  void disable_multishot() noexcept { multishot_ = false; }
+
+  static constexpr uint16_t buffer_group = 0;
+
+ private:
+  void provide(uint16_t id) noexcept {
+    auto* data = buffers_.get() + size_t{id} * buffer_size_;
+    if (buffer_ring_ == nullptr) {
+#if defined(IORING_RECV_MULTISHOT)
+      auto* sqe = prepare(provided_);
+      sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+      sqe->fd = 1;
+      sqe->addr = reinterpret_cast<uint64_t>(data);
+      sqe->len = buffer_size_;
+      sqe->off = id;
+      sqe->buf_group = buffer_group;
+#endif
+      return;
+    }
+
+    // Entries are laid out by hand: in C++ the flexible array of
+    // io_uring_buf_ring does not start at offset 0, and the tail overlays
+    // the reserved field of the first entry
+    auto* entries = static_cast<io_uring_buf*>(buffer_ring_);
+    std::atomic_ref<uint16_t> tail{entries[0].resv};
+    auto index = tail.load(std::memory_order_relaxed);
+    auto& entry = entries[index & (buffer_count_ - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(data);
+    entry.len = buffer_size_;
+    entry.bid = id;
+    tail.store(static_cast<uint16_t>(index + 1), std::memory_order_release);
+  }
+
+  void dispatch() {
+    ring_.reap([this](uint64_t user_data, int32_t res, uint32_t flags) {
+      auto* op = reinterpret_cast<uring_operation*>(user_data);
+      if (op == nullptr || op->complete == nullptr) {
+        return;
+      }
+      if (auto handle = op->complete(*op, res, flags)) {
+        --waiting_;
+        ready_.push_back(handle);
+      }
+    });
+  }
+
+  void setup_files(unsigned max_files) {
+    if (max_files == 0) {
+      return;
+    }
+    std::vector<int> table(max_files, -1);
+    if (ring_.register_resource(IORING_REGISTER_FILES, table.data(),
+                                max_files) < 0) {
+      return;
+    }
+    for (auto slot = static_cast<int>(max_files); slot-- > 0;) {
+      free_files_.push_back(slot);
+    }
+  }
+
+  bool update_file(int slot, int fd) noexcept {
+    io_uring_files_update update{};
+    update.offset = static_cast<uint32_t>(slot);
+    update.fds = reinterpret_cast<uint64_t>(&fd);
+    return ring_.register_resource(IORING_REGISTER_FILES_UPDATE, &update,
+                                   1) == 1;
+  }
+
+  void setup_buffers(unsigned count, unsigned size, bool use_ring) {
+#if defined(IORING_RECV_MULTISHOT)
+    if (count == 0 || (count & (count - 1)) != 0 || count > 32768) {
+      return;
+    }
+    if (use_ring) {
+      setup_buffer_ring(count);
+    }
+
+    // Receive buffers are never zero-filled, the kernel writes them first
+    buffers_.reset(new uint8_t[size_t{count} * size]);
+    buffer_count_ = count;
+    buffer_size_ = size;
+    if (buffer_ring_ != nullptr) {
+      for (unsigned id = 0; id < count; ++id) {
+        provide(static_cast<uint16_t>(id));
+      }
+    } else {
+      // All buffers with one submission, sent with the first enter. Kernels
+      // without multishot receive fail the receive, see disable_multishot()
+      auto* sqe = prepare(provided_);
+      sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+      sqe->fd = static_cast<int32_t>(count);
+      sqe->addr = reinterpret_cast<uint64_t>(buffers_.get());
+      sqe->len = size;
+      sqe->buf_group = buffer_group;
+    }
+    multishot_ = true;
+#else
+    (void)count;
+    (void)size;
+    (void)use_ring;
+#endif
+  }
+
+  /// Registers the ring that provided buffers are published to, leaves
+  /// buffer_ring_ empty if the kernel does not accept it.
+  void setup_buffer_ring(unsigned count) {
+#if defined(IORING_RECV_MULTISHOT)
+    buffer_ring_size_ = count * sizeof(io_uring_buf);
+    buffer_ring_ = ::mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer_ring_ == MAP_FAILED) {
+      buffer_ring_ = nullptr;
+      return;
+    }
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buffer_ring_);
+    reg.ring_entries = count;
+    reg.bgid = buffer_group;
+    if (ring_.register_resource(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+      ::munmap(buffer_ring_, buffer_ring_size_);
+      buffer_ring_ = nullptr;
+    }
+#else
+    (void)count;
+#endif
+  }
+
+  detail::uring ring_;
+  std::vector<int> free_files_;
+  std::vector<iovec> registered_;
+  void* buffer_ring_{};
+  size_t buffer_ring_size_{};
+  std::unique_ptr<uint8_t[]> buffers_;
+  unsigned buffer_count_{};
+  unsigned buffer_size_{};
+  size_t lent_{};
+  bool multishot_{};
+  size_t waiting_{};
+  std::vector<std::coroutine_handle<>> ready_;
+  std::vector<std::coroutine_handle<>> running_;
+  timer_wheel timers_;
+  uring_operation timeout_{[](uring_operation&, int32_t,
+                              uint32_t) -> std::coroutine_handle<> {
+    return {};
+  }};
+  __kernel_timespec timeout_spec_{};
+  // Completions of IORING_OP_PROVIDE_BUFFERS, which carry nothing to handle
+  uring_operation provided_{[](uring_operation&, int32_t,
+                               uint32_t) -> std::coroutine_handle<> {
+    return {};
+  }};
+};
+
+namespace detail {
+/// Descriptor of a TCP socket on a uring_context, shared by the blocking
+/// and the coroutine socket.
+class uring_descriptor {
+ public:
+  explicit uring_descriptor(uring_context& context) noexcept
+      : context_{&context} {}
+  uring_descriptor(uring_descriptor&& other) noexcept
+      : context_{other.context_},
+        fd_{std::exchange(other.fd_, -1)},
+        slot_{std::exchange(other.slot_, -1)} {}
+  uring_descriptor& operator=(uring_descriptor&& other) noexcept {
+    if (this != &other) {
+      std::error_code ec;
+      close(ec);
+      context_ = other.context_;
+      fd_ = std::exchange(other.fd_, -1);
+      slot_ = std::exchange(other.slot_, -1);
+    }
+    return *this;
+  }
+  ~uring_descriptor() {
+    std::error_code ec;
+    close(ec);
+  }
+
+  bool create(int family, std::error_code& ec) {
+    fd_ = ::socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+      ec = {errno, std::system_category()};
+      return false;
+    }
+    if (context_->valid()) {
+      slot_ = context_->install(fd_);
+    }
+    return true;
+  }
+
+  void shutdown(std::error_code& ec) noexcept {
+    if (fd_ >= 0 && ::shutdown(fd_, SHUT_RDWR) != 0) {
+      ec = {errno, std::system_category()};
+    }
+  }
+  void close(std::error_code& ec) noexcept {
+    if (fd_ < 0) {
+      return;
+    }
+    context_->uninstall(std::exchange(slot_, -1));
+    if (::close(std::exchange(fd_, -1)) != 0) {
+      ec = {errno, std::system_category()};
+    }
+  }
+
+  /// Prepares a submission for `op` aimed at this socket
+  io_uring_sqe* prepare(uring_operation& op, uint8_t opcode) noexcept {
+    auto* sqe = context_->prepare(op);
+    sqe->opcode = opcode;
+    uring_context::target(sqe, fd_, slot_);
+    return sqe;
+  }
+
+  /// Fills `sqe` to read into or write from `buffer`: *_FIXED if the memory
+  /// is registered, recv / send otherwise.
+  template <bool Write>
+  void prepare_io(uring_operation& op, std::span<const uint8_t> buffer) {
+    auto index = context_->registered_index(buffer.data(), buffer.size());
+    io_uring_sqe* sqe{};
+    if (index >= 0) {
+      sqe = prepare(op, Write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED);
+      sqe->buf_index = static_cast<uint16_t>(index);
+    } else {
+      sqe = prepare(op, Write ? IORING_OP_SEND : IORING_OP_RECV);
+      sqe->msg_flags = Write ? MSG_NOSIGNAL : 0;
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+    sqe->len = static_cast<uint32_t>(buffer.size());
+  }
+
+  uring_context& context() const noexcept { return *context_; }
+  int fd() const noexcept { return fd_; }
+  int slot() const noexcept { return slot_; }
+  bool uring() const noexcept { return context_->valid(); }
+
+ private:
+  uring_context* context_;
+  int fd_{-1};
+  int slot_{-1};
+};
+
+/// getaddrinfo results, freed on destruction
+struct address_list {
+  address_list(std::string_view host, std::string_view port,
+               std::error_code& ec) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (::getaddrinfo(std::string{host}.c_str(), std::string{port}.c_str(),
+                      &hints, &head) != 0) {
+      ec = std::make_error_code(std::errc::host_unreachable);
+      head = nullptr;
+    }
+  }
+  ~address_list() {
+    if (head != nullptr) {
+      ::freeaddrinfo(head);
+    }
+  }
+  address_list(const address_list&) = delete;
+  address_list& operator=(const address_list&) = delete;
+
+  addrinfo* head{};
+};
+
+/// Completion that a blocking call waits for
+struct uring_sync_operation : uring_operation {
+  uring_sync_operation() noexcept {
+    complete = [](uring_operation& op, int32_t res,
+                  uint32_t) -> std::coroutine_handle<> {
+      auto& self = static_cast<uring_sync_operation&>(op);
+      self.result = res;
+      self.done = true;
+      return {};
+    };
+  }
+
+  /// Waits for the completion, returns its result (negative errno)
+  int32_t wait(uring_context& context) {
+    context.wait_until([this] { return done; });
+    return result;
+  }
+
+  int32_t result{};
+  bool done{};
+};
+}  // namespace detail
+
+/// Blocking TCP socket over io_uring, satisfies concept_::vectored_socket,
+/// concept_::address_socket, concept_::direct_io_socket and
+/// concept_::timed_connect_socket.
+/// Every call is a single submission that the thread waits for; without
+/// io_uring it falls back to the plain system calls.
+class uring_socket {
+ public:
+  /// Plain TCP, bodies may go between the descriptor and files directly
+  static constexpr bool raw_descriptor = true;
+
+  explicit uring_socket(uring_context& context) noexcept
+      : descriptor_{context} {}
+
+  /// The descriptor is created by connect() once the address family is
+  /// known.
+  void open(std::error_code&) noexcept {}
+
+  void connect(std::string_view host, std::string_view port,
+               std::error_code& ec) {
+    detail::address_list addresses{host, port, ec};
+    for (auto* address = addresses.head; address != nullptr;
+         address = address->ai_next) {
+      if (connect(address->ai_addr, address->ai_addrlen, ec)) {
+        return;
+      }
+    }
+  }
+  /// Connects to a resolved address, see concept_::address_socket.
+  void connect(const http::address& address, std::error_code& ec) {
+    connect(address.data(), address.size(), ec);
+  }
+  /// Limits each following connect, see concept_::timed_connect_socket.
+  /// The connect submission is linked to a timeout, without io_uring the
+  /// limit is applied with SO_SNDTIMEO.
+  void connect_timeout(std::chrono::nanoseconds timeout) noexcept {
+    connect_timeout_ = timeout;
+  }
+
+  size_t read(std::span<uint8_t> buffer, std::error_code& ec) {
+    return io<false>(buffer, ec);
+  }
+  size_t write(std::span<const uint8_t> buffer, std::error_code& ec) {
+    return io<true>(buffer, ec);
+  }
+  /// Gathers up to IOV_MAX buffers into a single sendmsg.
+  size_t write(std::span<const const_buffer> buffers, std::error_code& ec) {
+    std::array<iovec, 64> iov;
+    auto count = std::min(buffers.size(), iov.size());
+    for (size_t i = 0; i < count; ++i) {
+      iov[i] = {const_cast<uint8_t*>(buffers[i].data()), buffers[i].size()};
+    }
+    msghdr message{};
+    message.msg_iov = iov.data();
+    message.msg_iovlen = count;
+
+    int64_t result{};
+    if (descriptor_.uring()) {
+      detail::uring_sync_operation op;
+      auto* sqe = descriptor_.prepare(op, IORING_OP_SENDMSG);
+      sqe->addr = reinterpret_cast<uint64_t>(&message);
+      sqe->len = 1;
+      sqe->msg_flags = MSG_NOSIGNAL;
+      result = op.wait(descriptor_.context());
+    } else {
+      result = ::sendmsg(descriptor_.fd(), &message, MSG_NOSIGNAL);
+      result = result < 0 ? -errno : result;
+    }
+    return finish(result, ec);
+  }
+
+  void shutdown(std::error_code& ec) noexcept { descriptor_.shutdown(ec); }
+  void close(std::error_code& ec) noexcept { descriptor_.close(ec); }
+
+  int native_handle() const noexcept { return descriptor_.fd(); }
+
+ private:
+  template <bool Write>
+  size_t io(std::span<const uint8_t> buffer, std::error_code& ec) {
+    int64_t result{};
+    if (descriptor_.uring()) {
+      detail::uring_sync_operation op;
+      descriptor_.prepare_io<Write>(op, buffer);
+      result = op.wait(descriptor_.context());
+    } else {
+      auto* data = const_cast<uint8_t*>(buffer.data());
+      result = Write ? ::send(descriptor_.fd(), data, buffer.size(),
+                              MSG_NOSIGNAL)
+                     : ::recv(descriptor_.fd(), data, buffer.size(), 0);
+      result = result < 0 ? -errno : result;
+    }
+    return finish(result, ec);
+  }
+
+  bool connect(const sockaddr* address, socklen_t size, std::error_code& ec) {
+    descriptor_.close(ec);
+    ec.clear();
+    if (!descriptor_.create(address->sa_family, ec)) {
+      return false;
+    }
+
+    bool limited = connect_timeout_.count() > 0;
+    auto seconds =
+        std::chrono::duration_cast<std::chrono::seconds>(connect_timeout_);
+    auto rest = connect_timeout_ - seconds;
+    int result{};
+    if (descriptor_.uring()) {
+      auto& context = descriptor_.context();
+      detail::uring_sync_operation op;
+      detail::uring_sync_operation timer;
+      __kernel_timespec limit{seconds.count(), rest.count()};
+      auto* sqe = descriptor_.prepare(op, IORING_OP_CONNECT);
+      sqe->addr = reinterpret_cast<uint64_t>(address);
+      sqe->off = size;
+      if (limited) {
+        // Cancels the connect once it expires
+        sqe->flags |= IOSQE_IO_LINK;
+        auto* timeout = context.prepare(timer);
+        timeout->opcode = IORING_OP_LINK_TIMEOUT;
+        timeout->addr = reinterpret_cast<uint64_t>(&limit);
+        timeout->len = 1;
+      } else {
+        timer.done = true;
+      }
+      result = op.wait(context);
+      // Both completions refer to this frame
+      timer.wait(context);
+      if (result == -ECANCELED && timer.result == -ETIME) {
+        result = -ETIMEDOUT;
+      }
+    } else {
+      timeval limit{static_cast<time_t>(seconds.count()),
+                    static_cast<suseconds_t>(rest.count() / 1000)};
+      if (limited) {
+        // Linux applies the send timeout to a blocking connect()
+        ::setsockopt(descriptor_.fd(), SOL_SOCKET, SO_SNDTIMEO, &limit,
+                     sizeof(limit));
+      }
+      if (::connect(descriptor_.fd(), address, size) != 0) {
+        result = errno == EINPROGRESS && limited ? -ETIMEDOUT : -errno;
+      }
+      if (limited) {
+        timeval none{};
+        ::setsockopt(descriptor_.fd(), SOL_SOCKET, SO_SNDTIMEO, &none,
+                     sizeof(none));
+      }
+    }
+    if (result != 0) {
+      ec = {-result, std::system_category()};
+    }
+    return result == 0;
+  }
+
+  static size_t finish(int64_t result, std::error_code& ec) noexcept {
+    if (result < 0) {
+      ec = {static_cast<int>(-result), std::system_category()};
+      return 0;
+    }
+    return static_cast<size_t>(result);
+  }
+
+  detail::uring_descriptor descriptor_;
+  std::chrono::nanoseconds connect_timeout_{};
+};
+
+/// Coroutine TCP socket over io_uring, satisfies concept_::async_socket.
+/// Reads use one multishot receive that stays armed across reads: data
+/// lands in the context's provided buffers and is copied into the caller's
+/// buffer on demand, so a read of already received data completes without
+/// a submission. Kernels without multishot receive get one recv per read
+/// straight into the caller's buffer. Satisfies concept_::cancellable_socket
+/// and concept_::async_address_socket.
+class uring_async_socket {
+ public:
+  explicit uring_async_socket(uring_context& context)
+      : state_{std::make_unique<state_t>(context)} {}
+
+  void open(std::error_code&) noexcept { state_->aborted.clear(); }
+
+  task<void> async_connect(std::string_view host, std::string_view port,
+                           std::error_code& ec) {
+    detail::address_list addresses{host, port, ec};
+    for (auto* address = addresses.head; address != nullptr;
+         address = address->ai_next) {
+      co_await connect_to(address->ai_addr, address->ai_addrlen, ec);
+      if (!ec || state_->aborted) {
+        co_return;
+      }
+    }
+  }
+  /// Connects to a resolved address, see concept_::async_address_socket.
+  task<void> async_connect(const http::address& address, std::error_code& ec) {
+    return connect_to(address.data(), address.size(), ec);
+  }
+
+  auto async_read(std::span<uint8_t> buffer, std::error_code& ec) noexcept {
+    return read_awaiter{*state_, buffer, ec};
+  }
+
+  task<size_t> async_write(std::span<const uint8_t> buffer,
+                           std::error_code& ec) {
+    if (state_->aborted) {
+      ec = state_->aborted;
+      co_return 0;
+    }
+    auto result = co_await single_shot{*state_, [&](uring_operation& op) {
+      state_->descriptor.prepare_io<true>(op, buffer);
+    }};
+    if (result < 0) {
+      ec = state_->failure(result);
+      co_return 0;
+    }
+    co_return static_cast<size_t>(result);
+  }
+
+  /// Completes the pending operations with `reason`, later ones fail with
+  /// it until the next open(). The cancellation is submitted with the next
+  /// run_once() of the context.
+  void cancel(std::error_code reason) {
+    auto& state = *state_;
+    state.aborted = reason;
+    if (state.descriptor.fd() >= 0 && state.descriptor.uring() &&
+        !state.cancelling) {
+      state.cancelling = true;
+      prepare_cancel(state.cancel);
+    }
+  }
+  timer_wheel& timers() noexcept {
+    return state_->descriptor.context().timers();
+  }
+
+  void shutdown(std::error_code& ec) noexcept {
+    state_->descriptor.shutdown(ec);
+  }
+
+  /// Cancels the operations still in flight, they complete with
+  /// operation_canceled. Waits for the armed receive to end, since its
+  /// completions refer to this socket.
+  void close(std::error_code& ec) {
+    auto& state = *state_;
+    auto& descriptor = state.descriptor;
+    auto& context = descriptor.context();
+    if (descriptor.fd() >= 0 && descriptor.uring()) {
+      state.closing = true;
+      detail::uring_sync_operation cancel;
+      prepare_cancel(cancel);
+      context.wait_until([&] {
+        return cancel.done && !state.armed && !state.cancelling;
+      });
+    }
+    for (; state.first < state.segments.size(); ++state.first) {
+      context.recycle(state.segments[state.first].id);
+    }
+    state.segments.clear();
+    state.first = 0;
+    state.eof = false;
+    state.error = 0;
+    state.closing = false;
+    descriptor.close(ec);
+  }
+
+  uring_async_socket(uring_async_socket&&) noexcept = default;
+  uring_async_socket& operator=(uring_async_socket&& other) noexcept {
+    if (this != &other) {
+      std::error_code ec;
+      if (state_) {
+        close(ec);
+      }
+      state_ = std::move(other.state_);
+    }
+    return *this;
+  }
+  ~uring_async_socket() {
+    if (state_) {
+      std::error_code ec;
+      close(ec);
+    }
+  }
+
+ private:
+  /// A received piece still in a provided buffer
+  struct segment_t {
+    uint16_t id;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct read_awaiter;
+  struct state_t;
+
+  /// An operation of the socket that resumes no coroutine: the multishot
+  /// receive queues its completions into the socket, the cancellation only
+  /// reports that it ended
+  struct receive_t : uring_operation {
+    state_t* state;
+  };
+
+  /// Lives on the heap so armed operations keep their address when the
+  /// socket is moved.
+  struct state_t {
+    explicit state_t(uring_context& context) : descriptor{context} {
+      recv.complete = &state_t::on_receive;
+      recv.state = this;
+      cancel.complete = [](uring_operation& op, int32_t,
+                           uint32_t) -> std::coroutine_handle<> {
+        static_cast<receive_t&>(op).state->cancelling = false;
+        return {};
+      };
+      cancel.state = this;
+    }
+
+    /// Error of a failed operation, the cancellation reason if there is one
+    std::error_code failure(int32_t res) const noexcept {
+      return aborted ? aborted : std::error_code{-res, std::system_category()};
+    }
+
+    static std::coroutine_handle<> on_receive(uring_operation& op,
+                                              int32_t res, uint32_t flags);
+
+    detail::uring_descriptor descriptor;
+    receive_t recv;
+    receive_t cancel;
+    bool armed{};
+    bool closing{};
+    bool cancelling{};
+    std::error_code aborted;
+    bool eof{};
+    int32_t error{};
+    std::vector<segment_t> segments;
+    size_t first{};
+    read_awaiter* reader{};
+  };
+
+  /// Awaits one submission prepared by `prepare(op)`
+  template <typename PrepareFn>
+  struct single_shot : uring_operation {
+    single_shot(state_t& state, PrepareFn prepare)
+        : state_{state}, prepare_{std::move(prepare)} {
+      complete = [](uring_operation& op, int32_t res,
+                    uint32_t) -> std::coroutine_handle<> {
+        auto& self = static_cast<single_shot&>(op);
+        self.result_ = res;
+        return self.handle_;
+      };
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+      handle_ = awaiting;
+      prepare_(*this);
+      state_.descriptor.context().suspended();
+    }
+    int32_t await_resume() const noexcept { return result_; }
+
+    state_t& state_;
+    PrepareFn prepare_;
+    std::coroutine_handle<> handle_;
+    int32_t result_{};
+  };
+
+  struct read_awaiter : uring_operation {
+    read_awaiter(state_t& state, std::span<uint8_t> buffer,
+                 std::error_code& ec) noexcept
+        : state_{state}, buffer_{buffer}, error_{&ec} {
+      complete = [](uring_operation& op, int32_t res,
+                    uint32_t) -> std::coroutine_handle<> {
+        auto& self = static_cast<read_awaiter&>(op);
+        self.finish(res);
+        return self.handle_;
+      };
+    }
+
+    bool await_ready() noexcept { return deliver(); }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+      handle_ = awaiting;
+      submit();
+      state_.descriptor.context().suspended();
+    }
+    size_t await_resume() const noexcept { return transferred_; }
+
+    /// Completes from received data, the end of stream or an error.
+    bool deliver() noexcept {
+      if (state_.aborted) {
+        *error_ = state_.aborted;
+        return true;
+      } else if (state_.first < state_.segments.size()) {
+        auto& context = state_.descriptor.context();
+        while (transferred_ < buffer_.size() &&
+               state_.first < state_.segments.size()) {
+          auto& segment = state_.segments[state_.first];
+          auto data = context.provided(segment.id, segment.offset +
+                                                       segment.size)
+                          .subspan(segment.offset);
+          auto size = std::min(data.size(), buffer_.size() - transferred_);
+          std::memcpy(buffer_.data() + transferred_, data.data(), size);
+          transferred_ += size;
+          segment.offset += static_cast<uint32_t>(size);
+          segment.size -= static_cast<uint32_t>(size);
+          if (segment.size == 0) {
+            context.recycle(segment.id);
+            ++state_.first;
+          }
+        }
+        if (state_.first == state_.segments.size()) {
+          state_.segments.clear();
+          state_.first = 0;
+        }
+        return true;
+      } else if (state_.error != 0) {
+        *error_ = state_.failure(std::exchange(state_.error, 0));
+        return true;
+      }
+      return state_.eof || state_.descriptor.fd() < 0;
+    }
+
+    /// Waits on the multishot receive of the socket, or submits a receive
+    /// of its own once multishot is off and the last one has ended (so the
+    /// two never race for data).
+    void submit() {
+      if (!state_.armed && !state_.descriptor.context().multishot()) {
+        state_.descriptor.prepare_io<false>(*this, buffer_);
+        return;
+      }
+      state_.reader = this;
+#if defined(IORING_RECV_MULTISHOT)
+      if (state_.armed) {
+        return;
+      }
+      auto* sqe = state_.descriptor.prepare(state_.recv, IORING_OP_RECV);
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->flags |= IOSQE_BUFFER_SELECT;
+      sqe->buf_group = uring_context::buffer_group;
+      state_.armed = true;
+#endif
+    }
+
+    void finish(int32_t res) noexcept {
+      if (res < 0) {
+        *error_ = state_.failure(res);
+      } else {
+        transferred_ = static_cast<size_t>(res);
+      }
+    }
+
+    state_t& state_;
+    std::span<uint8_t> buffer_;
+    std::error_code* error_;
+    std::coroutine_handle<> handle_;
+    size_t transferred_{};
+  };
+
+  task<void> connect_to(const sockaddr* address, socklen_t size,
+                        std::error_code& ec) {
+    close(ec);
+    ec.clear();
+    if (state_->aborted) {
+      ec = state_->aborted;
+      co_return;
+    } else if (!state_->descriptor.create(address->sa_family, ec)) {
+      co_return;
+    }
+    auto result = co_await single_shot{*state_, [&](uring_operation& op) {
+      auto* sqe = state_->descriptor.prepare(op, IORING_OP_CONNECT);
+      sqe->addr = reinterpret_cast<uint64_t>(address);
+      sqe->off = size;
+    }};
+    if (result != 0) {
+      ec = state_->failure(result);
+    }
+  }
+
+  /// Cancels every operation on the socket, `op` completes once done.
+  void prepare_cancel(uring_operation& op) noexcept {
+    auto& descriptor = state_->descriptor;
+    auto* sqe = descriptor.context().prepare(op);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_FD;
+    if (descriptor.slot() >= 0) {
+      sqe->fd = descriptor.slot();
+      sqe->cancel_flags |= IORING_ASYNC_CANCEL_FD_FIXED;
+    } else {
+      sqe->fd = descriptor.fd();
+    }
+  }
+
+  std::unique_ptr<state_t> state_;
+};
+
+inline std::coroutine_handle<> uring_async_socket::state_t::on_receive(
+    uring_operation& op, int32_t res, uint32_t flags) {
+  auto* state = static_cast<receive_t&>(op).state;
+  auto& context = state->descriptor.context();
+  if (!(flags & IORING_CQE_F_MORE)) {
+    state->armed = false;
+  }
+  if (state->closing && res < 0) {
+    // Nothing is submitted again while the socket closes
+    res = -ECANCELED;
+  }
+
+  if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+    auto id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    context.take();
+    state->segments.push_back({id, 0, static_cast<uint32_t>(res)});
+  } else if (res == 0) {
+    state->eof = true;
+  } else if (res == -EINVAL || res == -ENOBUFS) {
+    // Unknown to the kernel: read one by one from now on. Out of buffers
+    // only means the sockets did not hand enough of them back yet, the next
+    // read arms multishot again
+    if (res == -EINVAL) {
+      context.disable_multishot();
+    }
+    // Either way this read goes straight into the reader's buffer
+    auto* reader = std::exchange(state->reader, nullptr);
+    if (reader == nullptr || reader->deliver()) {
+      return reader != nullptr ? reader->handle_ : nullptr;
+    }
+    state->descriptor.prepare_io<false>(*reader, reader->buffer_);
+    return {};
+  } else if (res < 0) {
+    state->error = res;
+  }
+
+  auto* reader = std::exchange(state->reader, nullptr);
+  if (reader == nullptr) {
+    return {};
+  } else if (reader->deliver()) {
+    return reader->handle_;
+  }
+  // The receive ended without data for the reader, submit it again
+  reader->submit();
+  return {};
+}
+
+/// Calls `fn(executor, make_socket)` with a uring_context and
+/// uring_async_socket if the kernel provides io_uring, with an
+/// epoll_executor and epoll_socket otherwise. `fn` is instantiated for
+/// both, so it has to be generic.
+template <typename Fn>
+void with_best_executor(Fn&& fn) {
+  if (uring_context::supported()) {
+    uring_context context;
+    fn(context, [&context] { return uring_async_socket{context}; });
+  } else {
+    epoll_executor executor;
+    fn(executor, [&executor] { return epoll_socket{executor}; });
+  }
+}
+}  // namespace baklaga::http
+#endif  // defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+#endif  // BAKLAGA_HTTP_URING_HPP